@@ -0,0 +1,338 @@
+#include <iostream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <random>
+#include <cmath>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "opentld/TLDTracker.hpp"
+#include "opentld/Kernels.hpp"
+
+
+/* Times the hot paths on seeded synthetic frames. Every result is printed
+ * as one JSON object per line, so runs can be diffed and tracked. */
+
+
+struct BenchmarkConfig
+{
+    cv::Size frameSize;
+    int fernsCount;
+    int featuresCount;
+};
+
+
+struct BenchmarkSettings
+{
+    unsigned int seed;
+    int iterations;
+    double timeBudget;
+    size_t threadsCount;
+};
+
+
+template<class Function>
+void measure(const std::string &name, const BenchmarkConfig &config, const BenchmarkSettings &settings, Function function)
+{
+    function();
+    std::vector<double> times;
+    auto begin = std::chrono::steady_clock::now();
+    for (int iteration = 0; iteration < settings.iterations; ++iteration)
+    {
+        auto start = std::chrono::steady_clock::now();
+        function();
+        auto stop = std::chrono::steady_clock::now();
+        times.push_back(std::chrono::duration<double, std::micro>(stop - start).count());
+        if ((times.size() >= 3) && (std::chrono::duration<double>(stop - begin).count() > settings.timeBudget))
+        {
+            break;
+        }
+    }
+    std::sort(times.begin(), times.end());
+    double sum = 0.0;
+    for (auto time: times)
+    {
+        sum += time;
+    }
+    std::cout << "{\"benchmark\": \"" << name << "\""
+              << ", \"width\": " << config.frameSize.width << ", \"height\": " << config.frameSize.height
+              << ", \"ferns\": " << config.fernsCount << ", \"features\": " << config.featuresCount
+              << ", \"specialized\": " << (kernels::isSpecialized(config.fernsCount, config.featuresCount) ? "true" : "false")
+              << ", \"threads\": " << settings.threadsCount << ", \"simd\": " << (kernels::isSimdEnabled() ? "true" : "false")
+              << ", \"seed\": " << settings.seed << ", \"iterations\": " << times.size()
+              << ", \"min_us\": " << times.front() << ", \"median_us\": " << times.at(times.size() / 2)
+              << ", \"mean_us\": " << (sum / times.size()) << ", \"max_us\": " << times.back() << "}" << std::endl;
+}
+
+
+cv::Mat getSyntheticFrame(const cv::Size &size, const unsigned int seed)
+{
+    cv::RNG rng(seed);
+    cv::Mat noise(size, CV_8UC3);
+    rng.fill(noise, cv::RNG::UNIFORM, cv::Scalar(0, 0, 0), cv::Scalar(256, 256, 256));
+    cv::Mat frame;
+    cv::GaussianBlur(noise, frame, cv::Size(0, 0), 2.0);
+    return frame;
+}
+
+
+cv::Mat getShiftedFrame(const cv::Mat &frame, const double dx, const double dy)
+{
+    cv::Mat transform = cv::getRotationMatrix2D(cv::Point2f(0.0f, 0.0f), 0.0, 1.0);
+    transform.at<double>(0, 2) = dx;
+    transform.at<double>(1, 2) = dy;
+    cv::Mat shifted;
+    cv::warpAffine(frame, shifted, transform, frame.size(), cv::INTER_LINEAR, cv::BORDER_REPLICATE);
+    return shifted;
+}
+
+
+/* Median flow scale of the default 20x20 grid with noise and 20% outliers:
+ * the times of both the estimation modes and the relative error of the
+ * subsampled one against the exact median */
+void runScaleBenchmarks(const BenchmarkSettings &settings)
+{
+    const int trialsCount = 200;
+    std::mt19937 randomEngine(settings.seed);
+    std::uniform_real_distribution<float> scaleDistribution(0.9f, 1.1f);
+    std::normal_distribution<float> noiseDistribution(0.0f, 0.3f);
+    std::uniform_real_distribution<float> outlierDistribution(-10.0f, 10.0f);
+    std::vector<std::vector<cv::Point2f>> prevPoints(trialsCount);
+    std::vector<std::vector<cv::Point2f>> nextPoints(trialsCount);
+    for (int trial = 0; trial < trialsCount; ++trial)
+    {
+        float scale = scaleDistribution(randomEngine);
+        for (int i = 0; i < 20; ++i)
+        {
+            for (int j = 0; j < 20; ++j)
+            {
+                cv::Point2f point((100.0f + (3.0f * i)), (80.0f + (3.0f * j)));
+                cv::Point2f moved((110.0f + ((3.0f * i) - 30.0f) * scale + noiseDistribution(randomEngine)),
+                                  (85.0f + ((3.0f * j) - 30.0f) * scale + noiseDistribution(randomEngine)));
+                if ((randomEngine() % 5) == 0)
+                {
+                    moved.x += outlierDistribution(randomEngine);
+                    moved.y += outlierDistribution(randomEngine);
+                }
+                prevPoints[trial].push_back(point);
+                nextPoints[trial].push_back(moved);
+            }
+        }
+    }
+
+    BenchmarkConfig config;
+    config.frameSize = cv::Size(0, 0);
+    config.fernsCount = 0;
+    config.featuresCount = 0;
+    std::vector<float> ratios;
+    volatile double sink = 0.0;
+    const size_t maxPairsValues[] = {1024, 2048, 4096};
+    measure("Tracker::getScale(exact)", config, settings, [&]()
+    {
+        for (int trial = 0; trial < trialsCount; ++trial)
+        {
+            sink = Tracker::getScale(prevPoints[trial], nextPoints[trial], ScaleEstimation::Exact, 0, ratios);
+        }
+    });
+    for (auto maxPairs: maxPairsValues)
+    {
+        measure(("Tracker::getScale(subsampled " + std::to_string(maxPairs) + ")"), config, settings, [&]()
+        {
+            for (int trial = 0; trial < trialsCount; ++trial)
+            {
+                sink = Tracker::getScale(prevPoints[trial], nextPoints[trial], ScaleEstimation::Subsampled, maxPairs, ratios);
+            }
+        });
+        std::vector<double> errors;
+        for (int trial = 0; trial < trialsCount; ++trial)
+        {
+            double exact = Tracker::getScale(prevPoints[trial], nextPoints[trial], ScaleEstimation::Exact, 0, ratios);
+            double subsampled = Tracker::getScale(prevPoints[trial], nextPoints[trial], ScaleEstimation::Subsampled, maxPairs, ratios);
+            errors.push_back(std::fabs(subsampled - exact) / exact);
+        }
+        std::sort(errors.begin(), errors.end());
+        double sum = 0.0;
+        for (auto error: errors)
+        {
+            sum += error;
+        }
+        std::cout << "{\"benchmark\": \"Tracker::getScale(subsampled " << maxPairs << ") error\""
+                  << ", \"trials\": " << errors.size() << ", \"mean\": " << (sum / errors.size())
+                  << ", \"p50\": " << errors.at(errors.size() / 2)
+                  << ", \"p99\": " << errors.at(((errors.size() * 99) / 100) - 1)
+                  << ", \"max\": " << errors.back() << "}" << std::endl;
+    }
+}
+
+
+void runBenchmarks(const BenchmarkConfig &config, const BenchmarkSettings &settings)
+{
+    std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>(settings.threadsCount);
+    cv::Mat firstFrame = getSyntheticFrame(config.frameSize, settings.seed);
+    cv::Mat secondFrame = getShiftedFrame(firstFrame, 2.0, 1.0);
+    cv::Rect targetRect(((config.frameSize.width - 64) / 2), ((config.frameSize.height - 48) / 2), 64, 48);
+    FrameContext firstContext(firstFrame);
+    FrameContext secondContext(secondFrame);
+    const cv::Mat &integralFrame = firstContext.getIntegral();
+
+    Feature::setSeed(settings.seed);
+    std::shared_ptr<Classifier> classifier =
+        std::make_shared<Classifier>(config.fernsCount, config.featuresCount, 0.2, 0.5, pool);
+    classifier->init(firstContext, targetRect);
+
+    std::vector<cv::Rect> windows;
+    for (int y = 0; (y + targetRect.height) < config.frameSize.height; y += 8)
+    {
+        for (int x = 0; (x + targetRect.width) < config.frameSize.width; x += 8)
+        {
+            windows.push_back(cv::Rect(x, y, targetRect.width, targetRect.height));
+        }
+    }
+    std::vector<double> confidences(windows.size());
+    volatile double sink = 0.0;
+
+    measure("Fern::classify", config, settings, [&]()
+    {
+        double sum = 0.0;
+        for (const auto &window: windows)
+        {
+            sum += classifier->getFern(0).classify(integralFrame, window);
+        }
+        sink = sum;
+    });
+    measure("Classifier::classify", config, settings, [&]()
+    {
+        double sum = 0.0;
+        for (const auto &window: windows)
+        {
+            sum += classifier->classify(integralFrame, window);
+        }
+        sink = sum;
+    });
+    measure("Classifier::classify(batch)", config, settings, [&]()
+    {
+        classifier->classify(integralFrame, windows.data(), windows.size(), confidences.data());
+        sink = confidences.front();
+    });
+    measure("Classifier::trainPositive", config, settings, [&]()
+    {
+        classifier->trainPositive(firstContext, targetRect);
+    });
+    measure("Classifier::trainNegative", config, settings, [&]()
+    {
+        classifier->trainNegative(integralFrame, targetRect);
+    });
+
+    Detector detector(classifier, pool);
+    detector.init(firstContext, targetRect);
+    std::vector<Patch> patches;
+    measure("Detector::detect", config, settings, [&]()
+    {
+        detector.detect(secondContext, targetRect, patches);
+    });
+    detector.setRedetection(true);
+    measure("Detector::detect(redetection)", config, settings, [&]()
+    {
+        detector.detect(secondContext, targetRect, patches);
+    });
+    detector.setRedetection(false);
+
+    Tracker tracker(classifier);
+    tracker.init(firstContext);
+    bool isForward = true;
+    measure("Tracker::track", config, settings, [&]()
+    {
+        tracker.track((isForward ? secondContext : firstContext), targetRect);
+        isForward = !isForward;
+    });
+
+    Feature::setSeed(settings.seed);
+    TLDTracker tldTracker(config.fernsCount, config.featuresCount, 0.2, 0.5, pool);
+    cv::Rect roi = tldTracker.getTargetRect(firstFrame, targetRect);
+    isForward = true;
+    measure("TLDTracker::getTargetRect", config, settings, [&]()
+    {
+        roi = tldTracker.getTargetRect((isForward ? secondFrame : firstFrame), ((roi.area() > 0) ? roi : targetRect));
+        isForward = !isForward;
+    });
+    tldTracker.setRegionPreprocessing(true);
+    measure("TLDTracker::getTargetRect(region)", config, settings, [&]()
+    {
+        roi = tldTracker.getTargetRect((isForward ? secondFrame : firstFrame), ((roi.area() > 0) ? roi : targetRect));
+        isForward = !isForward;
+    });
+
+    /* Latency of a target selection, the negative bootstrapping dominates it */
+    measure("TLDTracker::init", config, settings, [&]()
+    {
+        tldTracker.resetTracker();
+        roi = tldTracker.getTargetRect(firstFrame, targetRect);
+    });
+    tldTracker.setNegativeSamplesLimit(4096);
+    measure("TLDTracker::init(capped 4096)", config, settings, [&]()
+    {
+        tldTracker.resetTracker();
+        roi = tldTracker.getTargetRect(firstFrame, targetRect);
+    });
+}
+
+
+int main(int argc, char* argv[])
+{
+    BenchmarkSettings settings;
+    settings.seed = 12345;
+    settings.iterations = 50;
+    settings.timeBudget = 2.0;
+    settings.threadsCount = ThreadPool::getDefaultThreadsCount();
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument(argv[i]);
+        bool hasValue = ((i + 1) < argc);
+        if ((argument == "--seed") && (hasValue == true))
+        {
+            settings.seed = static_cast<unsigned int>(std::strtoul(argv[++i], nullptr, 10));
+        }
+        else if ((argument == "--iterations") && (hasValue == true))
+        {
+            settings.iterations = std::max(1, std::atoi(argv[++i]));
+        }
+        else if ((argument == "--budget") && (hasValue == true))
+        {
+            settings.timeBudget = std::atof(argv[++i]);
+        }
+        else if ((argument == "--threads") && (hasValue == true))
+        {
+            settings.threadsCount = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        }
+        else if (argument == "--scalar")
+        {
+            kernels::setSimdEnabled(false);
+        }
+        else
+        {
+            std::cerr << "Usage: " << argv[0] << " [--seed value] [--iterations count] [--budget seconds]"
+                      << " [--threads count] [--scalar]" << std::endl;
+            return 1;
+        }
+    }
+
+    runScaleBenchmarks(settings);
+    const cv::Size frameSizes[] = {cv::Size(640, 480), cv::Size(1280, 720), cv::Size(1920, 1080)};
+    const int fernConfigs[][2] = {{12, 6}, {8, 8}, {24, 4}};
+    for (const auto &frameSize: frameSizes)
+    {
+        for (const auto &fernConfig: fernConfigs)
+        {
+            BenchmarkConfig config;
+            config.frameSize = frameSize;
+            config.fernsCount = fernConfig[0];
+            config.featuresCount = fernConfig[1];
+            runBenchmarks(config, settings);
+        }
+    }
+    return 0;
+}
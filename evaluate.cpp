@@ -0,0 +1,399 @@
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+#include <deque>
+#include <future>
+
+#include <opencv2/videoio.hpp>
+
+#include "opentld/TLDTracker.hpp"
+#include "opentld/AsyncTLDTracker.hpp"
+
+
+/* Headless run of TLDTracker over a video file or an image sequence
+ * (printf-like pattern, e.g. frames/%05d.jpg) with per-frame output
+ * and a throughput/latency/accuracy summary at the end. */
+
+
+struct FrameResult
+{
+    int frame;
+    cv::Rect rect;
+    TLDStatistics statistics;
+    double totalTime;
+    /* When the result was collected, milliseconds from the start of the run */
+    double doneTime;
+    bool hasGroundTruth;
+    double overlap;
+};
+
+
+void printUsage(const char *name)
+{
+    std::cerr << "Usage: " << name << " <video | image pattern> (--box x,y,w,h | --groundtruth file)\n"
+              << "       [--output results.csv | results.json] [--threads count] [--trace trace.json]\n"
+              << "       [--pipeline depth] [--fps rate]\n"
+              << "Ground truth files hold one x,y,w,h box per frame, NaN marks frames without the target.\n"
+              << "The frames are timestamped at --fps, by default the video rate (30 for image sequences)."
+              << std::endl;
+}
+
+
+bool parseRect(const std::string &text, cv::Rect &rect)
+{
+    std::string values(text);
+    std::replace(values.begin(), values.end(), ',', ' ');
+    std::istringstream stream(values);
+    std::vector<double> numbers;
+    std::string token;
+    while (stream >> token)
+    {
+        char *end = nullptr;
+        double number = std::strtod(token.c_str(), &end);
+        if ((end == token.c_str()) || (std::isfinite(number) == false))
+        {
+            return false;
+        }
+        numbers.push_back(number);
+    }
+    if ((numbers.size() != 4) || (numbers.at(2) <= 0.0) || (numbers.at(3) <= 0.0))
+    {
+        return false;
+    }
+    rect = cv::Rect(static_cast<int>(round(numbers.at(0))), static_cast<int>(round(numbers.at(1))),
+                    static_cast<int>(round(numbers.at(2))), static_cast<int>(round(numbers.at(3))));
+    return true;
+}
+
+
+bool readGroundTruth(const std::string &path, std::vector<cv::Rect> &boxes, std::vector<bool> &isValid)
+{
+    std::ifstream file(path);
+    if (file.is_open() == false)
+    {
+        return false;
+    }
+    std::string line;
+    while (std::getline(file, line))
+    {
+        cv::Rect box(0, 0, 0, 0);
+        isValid.push_back(parseRect(line, box));
+        boxes.push_back(box);
+    }
+    return true;
+}
+
+
+double getOverlap(const cv::Rect &first, const cv::Rect &second)
+{
+    double overlap = 0.0;
+    cv::Rect overlapRect = first & second;
+    if (overlapRect.area() > 0)
+    {
+        overlap = static_cast<double>(overlapRect.area()) / (first.area() + second.area() - overlapRect.area());
+    }
+    return overlap;
+}
+
+
+double getPercentile(std::vector<double> values, const double percentile)
+{
+    if (values.empty() == true)
+    {
+        return 0.0;
+    }
+    size_t rank = static_cast<size_t>(ceil((percentile / 100.0) * values.size()));
+    size_t index = std::min((values.size() - 1), ((rank > 0) ? (rank - 1) : 0));
+    std::nth_element(values.begin(), (values.begin() + index), values.end());
+    return values.at(index);
+}
+
+
+void writeCsv(std::ostream &stream, const std::vector<FrameResult> &results)
+{
+    stream << "frame,x,y,width,height,confidence,preprocessing_ms,tracking_ms,detection_ms,learning_ms,total_ms,iou\n";
+    for (const auto &result: results)
+    {
+        stream << result.frame << ',' << result.rect.x << ',' << result.rect.y << ','
+               << result.rect.width << ',' << result.rect.height << ','
+               << result.statistics.confidence << ',' << result.statistics.preprocessingTime << ','
+               << result.statistics.trackingTime << ',' << result.statistics.detectionTime << ','
+               << result.statistics.learningTime << ',' << result.totalTime << ',';
+        if (result.hasGroundTruth == true)
+        {
+            stream << result.overlap;
+        }
+        stream << '\n';
+    }
+}
+
+
+void writeJson(std::ostream &stream, const std::vector<FrameResult> &results)
+{
+    stream << "[\n";
+    for (size_t i = 0; i < results.size(); ++i)
+    {
+        const FrameResult &result = results.at(i);
+        stream << "  {\"frame\": " << result.frame
+               << ", \"box\": [" << result.rect.x << ", " << result.rect.y << ", "
+               << result.rect.width << ", " << result.rect.height << "]"
+               << ", \"confidence\": " << result.statistics.confidence
+               << ", \"preprocessing_ms\": " << result.statistics.preprocessingTime
+               << ", \"tracking_ms\": " << result.statistics.trackingTime
+               << ", \"detection_ms\": " << result.statistics.detectionTime
+               << ", \"learning_ms\": " << result.statistics.learningTime
+               << ", \"total_ms\": " << result.totalTime
+               << ", \"iou\": ";
+        if (result.hasGroundTruth == true)
+        {
+            stream << result.overlap;
+        }
+        else
+        {
+            stream << "null";
+        }
+        stream << "}" << (((i + 1) < results.size()) ? "," : "") << "\n";
+    }
+    stream << "]\n";
+}
+
+
+int main(int argc, char* argv[])
+{
+    std::string inputPath;
+    std::string boxText;
+    std::string groundTruthPath;
+    std::string outputPath;
+    std::string tracePath;
+    size_t pipelineDepth = 0;
+    double fps = 0.0;
+    size_t threadsCount = ThreadPool::getDefaultThreadsCount();
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument(argv[i]);
+        bool hasValue = ((i + 1) < argc);
+        if ((argument == "--box") && (hasValue == true))
+        {
+            boxText = argv[++i];
+        }
+        else if ((argument == "--groundtruth") && (hasValue == true))
+        {
+            groundTruthPath = argv[++i];
+        }
+        else if ((argument == "--output") && (hasValue == true))
+        {
+            outputPath = argv[++i];
+        }
+        else if ((argument == "--trace") && (hasValue == true))
+        {
+            tracePath = argv[++i];
+        }
+        else if ((argument == "--pipeline") && (hasValue == true))
+        {
+            pipelineDepth = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if ((argument == "--fps") && (hasValue == true))
+        {
+            fps = std::atof(argv[++i]);
+        }
+        else if ((argument == "--threads") && (hasValue == true))
+        {
+            threadsCount = static_cast<size_t>(std::max(0, std::atoi(argv[++i])));
+        }
+        else if ((argument.empty() == false) && (argument.at(0) != '-') && (inputPath.empty() == true))
+        {
+            inputPath = argument;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+
+    std::vector<cv::Rect> groundTruth;
+    std::vector<bool> hasGroundTruth;
+    if ((groundTruthPath.empty() == false) && (readGroundTruth(groundTruthPath, groundTruth, hasGroundTruth) == false))
+    {
+        std::cerr << "Cannot read the ground truth from " << groundTruthPath << std::endl;
+        return 1;
+    }
+    cv::Rect roi(0, 0, 0, 0);
+    if (boxText.empty() == false)
+    {
+        if (parseRect(boxText, roi) == false)
+        {
+            std::cerr << "Wrong initial box " << boxText << std::endl;
+            return 1;
+        }
+    }
+    else if ((hasGroundTruth.empty() == false) && (hasGroundTruth.at(0) == true))
+    {
+        roi = groundTruth.at(0);
+    }
+    if ((inputPath.empty() == true) || (roi.area() == 0))
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    cv::VideoCapture capture;
+    if (capture.open(inputPath) == false)
+    {
+        std::cerr << "Cannot open " << inputPath << std::endl;
+        return 1;
+    }
+    /* The motion prediction follows the video time, not the processing speed */
+    if (fps <= 0.0)
+    {
+        fps = capture.get(cv::CAP_PROP_FPS);
+    }
+    if (fps <= 0.0)
+    {
+        fps = 30.0;
+    }
+
+    std::vector<FrameResult> results;
+    auto begin = std::chrono::steady_clock::now();
+    auto addResult = [&](const int index, const cv::Rect &rect, const TLDStatistics &statistics, const double totalTime)
+    {
+        FrameResult result;
+        result.totalTime = totalTime;
+        result.doneTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - begin).count();
+        result.frame = index;
+        result.rect = rect;
+        result.statistics = statistics;
+        result.hasGroundTruth = ((static_cast<size_t>(index) < hasGroundTruth.size()) && (hasGroundTruth.at(index) == true));
+        result.overlap = (result.hasGroundTruth == true) ? getOverlap(rect, groundTruth.at(index)) : 0.0;
+        results.push_back(result);
+    };
+    std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>(threadsCount);
+    if (pipelineDepth == 0)
+    {
+        TLDTracker tracker(12, 6, 0.2, 0.5, pool);
+        cv::Mat frame;
+        for (int index = 0; capture.read(frame) == true; ++index)
+        {
+            auto frameStart = std::chrono::steady_clock::now();
+            roi = tracker.getTargetRect(frame, roi, FrameFormat::Rgb, (index / fps));
+            addResult(index, roi, tracker.getStatistics(),
+                      std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - frameStart).count());
+        }
+    }
+    else
+    {
+        /* The decoding of the next frames overlaps with the processing, the
+         * total time of a frame is its latency from the submission */
+        AsyncTLDTracker tracker(roi, pipelineDepth, 12, 6, 0.2, 0.5, pool);
+        std::deque<std::pair<std::chrono::steady_clock::time_point, std::future<TrackingResult>>> pending;
+        auto collect = [&](const bool isWaiting)
+        {
+            while ((pending.empty() == false)
+                && ((isWaiting == true)
+                    || (pending.front().second.wait_for(std::chrono::seconds(0)) == std::future_status::ready)))
+            {
+                TrackingResult result = pending.front().second.get();
+                double totalTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now()
+                                                                             - pending.front().first).count();
+                addResult(static_cast<int>(result.frameIndex), result.rect, result.statistics, totalTime);
+                pending.pop_front();
+            }
+        };
+        for (int index = 0; ; ++index)
+        {
+            cv::Mat frame;
+            if (capture.read(frame) == false)
+            {
+                break;
+            }
+            auto submitTime = std::chrono::steady_clock::now();
+            pending.push_back(std::make_pair(submitTime, tracker.submit(frame, nullptr, (index / fps))));
+            collect(false);
+        }
+        collect(true);
+    }
+    double wallTime = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    capture.release();
+
+    if (outputPath.empty() == false)
+    {
+        std::ofstream output(outputPath);
+        if (output.is_open() == false)
+        {
+            std::cerr << "Cannot write " << outputPath << std::endl;
+            return 1;
+        }
+        bool isJson = ((outputPath.size() >= 5) && (outputPath.compare(outputPath.size() - 5, 5, ".json") == 0));
+        if (isJson == true)
+        {
+            writeJson(output, results);
+        }
+        else
+        {
+            writeCsv(output, results);
+        }
+    }
+
+    if ((tracePath.empty() == false) && (trace::writeChromeTrace(tracePath) == false))
+    {
+        std::cerr << "Cannot write " << tracePath << std::endl;
+        return 1;
+    }
+
+    /* The first frame only initializes the model, it is left out of the summary.
+     * In the pipeline the frames overlap, so the tracking time is the wall time
+     * from the first result to the last one and the latency of a frame is the
+     * sum of its stages; the time from the submission adds the queues. */
+    std::vector<double> latencies;
+    std::vector<double> queueLatencies;
+    double trackingTime = 0.0;
+    double overlapSum = 0.0;
+    size_t overlapCount = 0;
+    for (size_t i = 1; i < results.size(); ++i)
+    {
+        const TLDStatistics &statistics = results.at(i).statistics;
+        if (pipelineDepth == 0)
+        {
+            latencies.push_back(results.at(i).totalTime);
+            trackingTime += results.at(i).totalTime;
+        }
+        else
+        {
+            latencies.push_back(statistics.preprocessingTime + statistics.trackingTime + statistics.detectionTime
+                                + statistics.learningTime);
+            queueLatencies.push_back(results.at(i).totalTime);
+        }
+        if (results.at(i).hasGroundTruth == true)
+        {
+            overlapSum += results.at(i).overlap;
+            ++overlapCount;
+        }
+    }
+    if ((pipelineDepth > 0) && (results.size() > 1))
+    {
+        trackingTime = results.back().doneTime - results.front().doneTime;
+    }
+    std::cout << "frames: " << results.size() << "\n"
+              << "initialization (ms): " << ((results.empty() == false) ? results.at(0).totalTime : 0.0) << "\n"
+              << "throughput (FPS): " << ((trackingTime > 0.0) ? ((1000.0 * latencies.size()) / trackingTime) : 0.0) << "\n"
+              << "throughput with decoding (FPS): " << ((wallTime > 0.0) ? (results.size() / wallTime) : 0.0) << "\n"
+              << "latency p50 (ms): " << getPercentile(latencies, 50.0) << "\n"
+              << "latency p99 (ms): " << getPercentile(latencies, 99.0) << "\n";
+    if (pipelineDepth > 0)
+    {
+        std::cout << "latency with queueing p50 (ms): " << getPercentile(queueLatencies, 50.0) << "\n"
+                  << "latency with queueing p99 (ms): " << getPercentile(queueLatencies, 99.0) << "\n";
+    }
+    if (overlapCount > 0)
+    {
+        std::cout << "mean IoU: " << (overlapSum / overlapCount) << "\n";
+    }
+    std::cout << std::flush;
+    return 0;
+}
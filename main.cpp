@@ -1,5 +1,4 @@
 #include <iostream>
-#include <chrono>
 
 #include <opencv2/highgui.hpp>
 #include <opencv2/videoio.hpp>
@@ -87,10 +86,7 @@ int main(int argc, char* argv[])
             {
                 if (isTargetSelected == true)
                 {
-                    auto begin = std::chrono::high_resolution_clock::now();
                     roi = tracker.getTargetRect(frame, roi);
-                    auto end = std::chrono::high_resolution_clock::now();
-                    std::cout << "Time elapsed = " << std::chrono::duration_cast<std::chrono::milliseconds>(end - begin).count() << std::endl;
                 }
                 cv::rectangle(frame, roi, cv::Scalar(0, 255, 0));
                 cv::imshow("Output", frame);
@@ -103,5 +99,9 @@ int main(int argc, char* argv[])
         key = cv::waitKey(20);
     }
     capture.release();
+    if (trace::isCompiled() == true)
+    {
+        trace::writeChromeTrace("OpenTLD.trace.json");
+    }
     return 0;
 }
@@ -0,0 +1,112 @@
+#include "AsyncTLDTracker.hpp"
+
+
+AsyncTLDTracker::AsyncTLDTracker(const cv::Rect &targetRect, const size_t depth,
+                                 const int ferns, const int nodes, const double minFeatureScale,
+                                 const double maxFeatureScale, std::shared_ptr<ThreadPool> pool)
+: tracker(ferns, nodes, minFeatureScale, maxFeatureScale, pool), submittedJobs(depth), preparedJobs(depth),
+  nextIndex(0), isNewTarget(true), newTargetRect(targetRect), targetRect(targetRect)
+{
+    preprocessingThread = std::thread(&AsyncTLDTracker::runPreprocessing, this);
+    trackingThread = std::thread(&AsyncTLDTracker::runTracking, this);
+}
+
+
+AsyncTLDTracker::~AsyncTLDTracker()
+{
+    submittedJobs.close();
+    preprocessingThread.join();
+    trackingThread.join();
+}
+
+
+std::future<TrackingResult> AsyncTLDTracker::submit(const cv::Mat &frameRGB, ResultCallback callback,
+                                                    const double timestamp)
+{
+    std::shared_ptr<Job> job = std::make_shared<Job>();
+    job->index = nextIndex++;
+    job->frame = frameRGB;
+    job->isNewTarget = isNewTarget;
+    job->targetRect = newTargetRect;
+    job->timestamp = ((timestamp >= 0.0) ? timestamp : FrameContext::getClockTime());
+    job->preprocessingTime = 0.0;
+    job->callback = callback;
+    isNewTarget = false;
+    std::future<TrackingResult> result = job->promise.get_future();
+    submittedJobs.push(job);
+    return result;
+}
+
+
+void AsyncTLDTracker::setTarget(const cv::Rect &targetRect)
+{
+    isNewTarget = true;
+    newTargetRect = targetRect;
+}
+
+
+void AsyncTLDTracker::runPreprocessing()
+{
+    TLD_TRACE_THREAD_NAME("pipeline preprocessing");
+    std::shared_ptr<Job> job;
+    while (submittedJobs.pop(job) == true)
+    {
+        TLD_TRACE_SCOPE("AsyncTLDTracker::preprocessing");
+        auto start = std::chrono::steady_clock::now();
+        try
+        {
+            job->context.reset(new FrameContext(job->frame));
+            job->context->setTimestamp(job->timestamp);
+            tracker.prepare(*(job->context));
+        }
+        catch (...)
+        {
+            job->exception = std::current_exception();
+        }
+        job->preprocessingTime = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        preparedJobs.push(job);
+    }
+    preparedJobs.close();
+}
+
+
+void AsyncTLDTracker::runTracking()
+{
+    TLD_TRACE_THREAD_NAME("pipeline tracking");
+    std::shared_ptr<Job> job;
+    while (preparedJobs.pop(job) == true)
+    {
+        TLD_TRACE_SCOPE("AsyncTLDTracker::tracking");
+        if (job->exception != nullptr)
+        {
+            job->promise.set_exception(job->exception);
+            continue;
+        }
+        try
+        {
+            if (job->isNewTarget == true)
+            {
+                tracker.resetTracker();
+                targetRect = job->targetRect;
+            }
+            targetRect = tracker.getTargetRect(*(job->context), targetRect);
+            TrackingResult result;
+            result.frameIndex = job->index;
+            result.rect = targetRect;
+            result.statistics = tracker.getStatistics();
+            result.statistics.preprocessingTime = job->preprocessingTime;
+            /* The frame products are not needed any more */
+            job->context.reset();
+            job->frame.release();
+            if (job->callback != nullptr)
+            {
+                job->callback(result);
+            }
+            job->promise.set_value(result);
+        }
+        catch (...)
+        {
+            job->promise.set_exception(std::current_exception());
+        }
+    }
+}
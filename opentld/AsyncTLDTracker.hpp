@@ -0,0 +1,86 @@
+#ifndef ASYNCTLDTRACKER_HPP
+#define ASYNCTLDTRACKER_HPP
+
+#include <memory>
+#include <thread>
+#include <future>
+#include <functional>
+#include <chrono>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "ThreadPool.hpp"
+#include "FrameContext.hpp"
+#include "BoundedQueue.hpp"
+#include "TLDTracker.hpp"
+#include "Trace.hpp"
+
+
+struct TrackingResult
+{
+    TrackingResult()
+        : frameIndex(0), rect(0, 0, 0, 0) {}
+    size_t frameIndex;
+    cv::Rect rect;
+    TLDStatistics statistics;
+};
+
+
+/* TLDTracker behind a two-stage pipeline: one thread preprocesses the
+ * frames (color conversion, blur, integrals, pyramid) while another one
+ * tracks, detects and learns on the previous frame. The frames are
+ * processed in the submission order, so the results match the
+ * synchronous getTargetRect() calls. At most depth frames wait in each
+ * stage, submit() blocks when the pipeline is full. */
+class AsyncTLDTracker
+{
+public:
+    using ResultCallback = std::function<void(const TrackingResult &result)>;
+
+    explicit AsyncTLDTracker(const cv::Rect &targetRect, const size_t depth = 2,
+                             const int ferns = 12, const int nodes = 6, const double minFeatureScale = 0.2,
+                             const double maxFeatureScale = 0.5, std::shared_ptr<ThreadPool> pool = nullptr);
+    /* Completes the submitted frames */
+    ~AsyncTLDTracker();
+    AsyncTLDTracker(const AsyncTLDTracker &other) = delete;
+    AsyncTLDTracker &operator=(const AsyncTLDTracker &other) = delete;
+    /* The pipeline keeps a reference to the frame data, so the caller must
+     * not write into it afterwards (read every frame into a new cv::Mat).
+     * The callback runs on the pipeline thread before the future is ready,
+     * the exceptions of the stages are delivered through the future.
+     * A negative timestamp (see TLDTracker) takes the time of the submission. */
+    std::future<TrackingResult> submit(const cv::Mat &frameRGB, ResultCallback callback = nullptr,
+                                       const double timestamp = -1.0);
+    /* The next submitted frame learns the target anew */
+    void setTarget(const cv::Rect &targetRect);
+
+private:
+    struct Job
+    {
+        size_t index;
+        cv::Mat frame;
+        std::unique_ptr<FrameContext> context;
+        bool isNewTarget;
+        cv::Rect targetRect;
+        double timestamp;
+        double preprocessingTime;
+        ResultCallback callback;
+        std::promise<TrackingResult> promise;
+        std::exception_ptr exception;
+    };
+
+    TLDTracker tracker;
+    BoundedQueue<std::shared_ptr<Job>> submittedJobs;
+    BoundedQueue<std::shared_ptr<Job>> preparedJobs;
+    size_t nextIndex;
+    bool isNewTarget;
+    cv::Rect newTargetRect;
+    cv::Rect targetRect;
+    std::thread preprocessingThread;
+    std::thread trackingThread;
+
+    void runPreprocessing();
+    void runTracking();
+};
+
+#endif /* ASYNCTLDTRACKER_HPP */
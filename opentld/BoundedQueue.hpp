@@ -0,0 +1,137 @@
+#ifndef BOUNDEDQUEUE_HPP
+#define BOUNDEDQUEUE_HPP
+
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+
+
+/* FIFO of at most capacity items shared by producer and consumer threads.
+ * Producers choose what happens when it is full: fail, wait for a free
+ * place or drop the oldest item (the usual choice for live sources). */
+template<class T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(const size_t capacity)
+        : capacity((capacity > 0) ? capacity : 1), isClosed(false) {}
+    ~BoundedQueue() = default;
+    BoundedQueue(const BoundedQueue &other) = delete;
+    BoundedQueue &operator=(const BoundedQueue &other) = delete;
+
+    /* Returns false when the queue is full or closed */
+    bool tryPush(T item)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if ((isClosed == true) || (items.size() >= capacity))
+        {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /* Waits for a free place, returns false when the queue gets closed */
+    bool push(T item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notFull.wait(lock, [this] { return ((isClosed == true) || (items.size() < capacity)); });
+        if (isClosed == true)
+        {
+            return false;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return true;
+    }
+
+    /* Returns the count of dropped items (0 or 1), the item is lost when the queue is closed */
+    size_t pushDroppingOldest(T item)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (isClosed == true)
+        {
+            return 0;
+        }
+        size_t droppedCount = 0;
+        if (items.size() >= capacity)
+        {
+            items.pop_front();
+            droppedCount = 1;
+        }
+        items.push_back(std::move(item));
+        notEmpty.notify_one();
+        return droppedCount;
+    }
+
+    bool tryPop(T &item)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (items.empty() == true)
+        {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    /* Waits for an item, returns false when the queue is closed and empty */
+    bool pop(T &item)
+    {
+        std::unique_lock<std::mutex> lock(mutex);
+        notEmpty.wait(lock, [this] { return ((isClosed == true) || (items.empty() == false)); });
+        if (items.empty() == true)
+        {
+            return false;
+        }
+        item = std::move(items.front());
+        items.pop_front();
+        notFull.notify_one();
+        return true;
+    }
+
+    /* Wakes the waiting producers and consumers, the queued items stay poppable */
+    void close()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        isClosed = true;
+        notFull.notify_all();
+        notEmpty.notify_all();
+    }
+
+    void clear()
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        items.clear();
+        notFull.notify_all();
+    }
+
+    size_t size() const
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        return items.size();
+    }
+
+    bool empty() const
+    {
+        return (size() == 0);
+    }
+
+    size_t getCapacity() const
+    {
+        return capacity;
+    }
+
+private:
+    const size_t capacity;
+    mutable std::mutex mutex;
+    std::condition_variable notFull;
+    std::condition_variable notEmpty;
+    std::deque<T> items;
+    bool isClosed;
+};
+
+#endif /* BOUNDEDQUEUE_HPP */
@@ -2,56 +2,246 @@
 #include <iostream>
 
 
-Classifier::Classifier(const int fernsCount, const int featuresCount, const double minFeatureScale, const double maxFeatureScale)
+Classifier::Classifier(const int fernsCount, const int featuresCount, const double minFeatureScale, const double maxFeatureScale,
+                       std::shared_ptr<ThreadPool> &pool)
+: fernsCount(fernsCount), featuresCount(featuresCount), leafsCount(1 << (2 * featuresCount)),
+  leafs(fernsCount * leafsCount), posteriors((fernsCount * leafsCount) + 1, 0),
+  touchedLeafs(fernsCount * leafsCount), touchedLeafsCount(0), pool(pool), negativeSamplesLimit(0),
+  hardNegativesBudget(128)
 {
+    features.reserve(fernsCount * featuresCount);
+    for (int feature = 0; feature < (fernsCount * featuresCount); ++feature)
+    {
+        features.push_back(Feature(minFeatureScale, maxFeatureScale));
+    }
     for (int fern = 0; fern < fernsCount; ++fern)
     {
-        ferns.push_back(std::make_shared<Fern>(featuresCount, minFeatureScale, maxFeatureScale));
+        ferns.push_back(Fern(&(features[fern * featuresCount]), featuresCount, &(posteriors[fern * leafsCount])));
     }
 }
 
 
 void Classifier::train(const cv::Mat &frame, const cv::Rect &patchRect, const bool isPositive)
 {
-    for (auto fern: ferns)
+    for (int fern = 0; fern < fernsCount; ++fern)
     {
-        fern->train(frame, patchRect, isPositive);
+        int leaf = (fern * leafsCount) + ferns[fern].getLeafIndex(frame, patchRect);
+        bool isFirstTouch = ((isPositive == true) ? leafs[leaf].increment() : leafs[leaf].decrement());
+        if (isFirstTouch == true)
+        {
+            touchedLeafs[touchedLeafsCount.fetch_add(1, std::memory_order_relaxed)] = leaf;
+        }
     }
 }
 
 
+void Classifier::train(const FrameContext &context, const cv::Rect &patchRect, const bool isPositive)
+{
+    train(context.getIntegral(), patchRect, isPositive);
+}
+
+
+void Classifier::update()
+{
+    int count = touchedLeafsCount.load(std::memory_order_relaxed);
+    for (int touched = 0; touched < count; ++touched)
+    {
+        int leaf = touchedLeafs[touched];
+        posteriors[leaf] = static_cast<uint16_t>(round(leafs[leaf].update() * Fern::posteriorScale));
+    }
+    touchedLeafsCount.store(0, std::memory_order_relaxed);
+}
+
+
+void Classifier::reset()
+{
+    for (auto &leaf: leafs)
+    {
+        leaf.reset();
+    }
+    std::fill(posteriors.begin(), posteriors.end(), 0);
+    touchedLeafsCount.store(0, std::memory_order_relaxed);
+}
+
+
 void Classifier::trainNegative(const cv::Mat &frame, const cv::Rect &patchRect)
 {
+    TLD_TRACE_SCOPE("Classifier::trainNegative");
     double minScale = 0.5;
     double maxScale = 1.5;
     double scaleStep = 0.25;
+    int step = static_cast<int>(frame.step1());
+    /* The windows of a scale share the feature offsets, so they are kept
+     * as top-left offsets in the frame grouped by scale */
+    std::vector<cv::Size> sizes;
+    std::vector<size_t> scaleBegins;
+    negativeOffsets.clear();
     for (double scale = minScale; scale <= maxScale; scale += scaleStep)
     {
-        int xMin = 0;
-        int currentWidth = static_cast<int>(round(scale * patchRect.width));
-        int xMax = frame.cols - currentWidth;
-        int xStep = 10;
-        for (int x = xMin; x < xMax; x += xStep)
-        {
-            int yMin = 0;
-            int currentHeight = static_cast<int>(round(scale * patchRect.height));
-            int yMax = frame.rows - currentHeight;
-            int yStep = 10;
-            for (int y = yMin; y < yMax; y += yStep)
+        cv::Size size(static_cast<int>(round(scale * patchRect.width)), static_cast<int>(round(scale * patchRect.height)));
+        sizes.push_back(size);
+        scaleBegins.push_back(negativeOffsets.size());
+        int xMax = frame.cols - size.width;
+        int yMax = frame.rows - size.height;
+        for (int x = 0; x < xMax; x += 10)
+        {
+            for (int y = 0; y < yMax; y += 10)
+            {
+                if (getRectsOverlap(patchRect, cv::Rect(x, y, size.width, size.height)) < minimumOverlap)
+                {
+                    negativeOffsets.push_back((y * step) + x);
+                }
+            }
+        }
+    }
+    scaleBegins.push_back(negativeOffsets.size());
+    if ((negativeSamplesLimit > 0) && (negativeOffsets.size() > negativeSamplesLimit))
+    {
+        /* Stratified by scale, every scale keeps its share of the limit and
+         * takes evenly spaced windows of its column-major scan */
+        size_t total = negativeOffsets.size();
+        size_t kept = 0;
+        for (size_t scale = 0; scale < sizes.size(); ++scale)
+        {
+            size_t begin = scaleBegins[scale];
+            size_t count = scaleBegins[scale + 1] - begin;
+            size_t quota = std::min(count, static_cast<size_t>(ceil(static_cast<double>(negativeSamplesLimit) * count / total)));
+            scaleBegins[scale] = kept;
+            for (size_t sample = 0; sample < quota; ++sample)
+            {
+                negativeOffsets[kept++] = negativeOffsets[begin + ((sample * count) / quota)];
+            }
+        }
+        scaleBegins.back() = kept;
+        negativeOffsets.resize(kept);
+    }
+    size_t windowsCount = negativeOffsets.size();
+    if (windowsCount == 0)
+    {
+        return;
+    }
+    /* Leaf indices of all windows, fern-major so that every fern histogram
+     * reads a contiguous range */
+    negativeLeafIndices.resize(fernsCount * windowsCount);
+    size_t featureOffsetsCount = features.size() * Feature::cornersCount;
+    negativeFeatureOffsets.resize(sizes.size() * featureOffsetsCount);
+    for (size_t scale = 0; scale < sizes.size(); ++scale)
+    {
+        for (size_t feature = 0; feature < features.size(); ++feature)
+        {
+            features[feature].getOffsets(sizes[scale], step,
+                                         &(negativeFeatureOffsets[(scale * featureOffsetsCount) + (feature * Feature::cornersCount)]));
+        }
+    }
+    TLD_TRACE_COUNTER("Classifier::negativeWindows", windowsCount);
+    pool->parallelFor(windowsCount, [this, &frame, &scaleBegins, featureOffsetsCount, windowsCount](const size_t begin, const size_t end)
+    {
+        size_t window = begin;
+        size_t scale = 0;
+        while (window < end)
+        {
+            while (scaleBegins[scale + 1] <= window)
+            {
+                ++scale;
+            }
+            size_t batchEnd = std::min(end, scaleBegins[scale + 1]);
+            kernels::getLeafIndices(frame.ptr<int>(), &(negativeOffsets[window]), (batchEnd - window),
+                                    &(negativeFeatureOffsets[scale * featureOffsetsCount]), fernsCount, featuresCount,
+                                    &(negativeLeafIndices[window]), windowsCount);
+            window = batchEnd;
+        }
+    }, 1024);
+    /* One histogram per fern, every leaf gets its count in a single update */
+    pool->parallelFor(fernsCount, [this, windowsCount](const size_t begin, const size_t end)
+    {
+        std::vector<uint32_t> counts(leafsCount);
+        for (size_t fern = begin; fern < end; ++fern)
+        {
+            std::fill(counts.begin(), counts.end(), 0);
+            const int *leafIndices = &(negativeLeafIndices[fern * windowsCount]);
+            for (size_t window = 0; window < windowsCount; ++window)
             {
-                cv::Rect negativePatchRect(x, y, currentWidth, currentHeight);
-                if (getRectsOverlap(patchRect, negativePatchRect) < minimumOverlap)
+                ++counts[leafIndices[window]];
+            }
+            for (int leaf = 0; leaf < leafsCount; ++leaf)
+            {
+                if (counts[leaf] > 0)
                 {
-                    train(frame, negativePatchRect, false);
+                    int index = (static_cast<int>(fern) * leafsCount) + leaf;
+                    if (leafs[index].decrement(counts[leaf]) == true)
+                    {
+                        touchedLeafs[touchedLeafsCount.fetch_add(1, std::memory_order_relaxed)] = index;
+                    }
                 }
             }
         }
+    }, 1);
+    update();
+}
+
+
+void Classifier::setNegativeSamplesLimit(const size_t limit)
+{
+    negativeSamplesLimit = limit;
+}
+
+
+size_t Classifier::trainHardNegatives(const cv::Mat &frame, const std::vector<cv::Rect> &rects,
+                                      const std::vector<double> &confidences)
+{
+    TLD_TRACE_SCOPE("Classifier::trainHardNegatives");
+    /* Only a few times the budget is ranked, the duplicates are rare past the hardest ones */
+    size_t examinedCount = std::min(rects.size(), (4 * hardNegativesBudget));
+    hardNegativesOrder.resize(rects.size());
+    std::iota(hardNegativesOrder.begin(), hardNegativesOrder.end(), 0);
+    std::partial_sort(hardNegativesOrder.begin(), (hardNegativesOrder.begin() + examinedCount), hardNegativesOrder.end(),
+                      [&confidences](const size_t first, const size_t second) { return (confidences[first] > confidences[second]); });
+    hardNegativesCodes.clear();
+    hardNegativesLeafs.clear();
+    size_t trainedCount = 0;
+    for (size_t i = 0; (i < examinedCount) && (trainedCount < hardNegativesBudget); ++i)
+    {
+        const cv::Rect &rect = rects[hardNegativesOrder[i]];
+        size_t first = hardNegativesLeafs.size();
+        /* FNV-1a over the leafs of all the ferns */
+        uint64_t code = 14695981039346656037ULL;
+        for (int fern = 0; fern < fernsCount; ++fern)
+        {
+            int leaf = ferns[fern].getLeafIndex(frame, rect);
+            hardNegativesLeafs.push_back((fern * leafsCount) + leaf);
+            code = (code ^ static_cast<uint64_t>(leaf)) * 1099511628211ULL;
+        }
+        if (hardNegativesCodes.insert(code).second == false)
+        {
+            hardNegativesLeafs.resize(first);
+            continue;
+        }
+        ++trainedCount;
+    }
+    for (int leaf: hardNegativesLeafs)
+    {
+        if (leafs[leaf].decrement() == true)
+        {
+            touchedLeafs[touchedLeafsCount.fetch_add(1, std::memory_order_relaxed)] = leaf;
+        }
     }
+    TLD_TRACE_COUNTER("Classifier::hardNegatives", trainedCount);
+    return trainedCount;
 }
 
 
-void Classifier::trainPositive(const cv::Mat &frame, const cv::Rect &patchRect)
+void Classifier::setHardNegativesBudget(const size_t budget)
 {
+    hardNegativesBudget = budget;
+}
+
+
+void Classifier::trainPositive(const FrameContext &context, const cv::Rect &patchRect)
+{
+    TLD_TRACE_SCOPE("Classifier::trainPositive");
+    const cv::Mat &frame = context.getFrame();
+    /* The patches and the warps read only the computed part of the frame */
+    const cv::Rect &frameRegion = context.getRegion();
     cv::Point2f patchRectCenter = getRectCenter(patchRect);
 
     std::set<int> widths;
@@ -62,7 +252,7 @@ void Classifier::trainPositive(const cv::Mat &frame, const cv::Rect &patchRect)
         int width = static_cast<int>(round(patchRect.width * scale));
         int minX = (patchRectCenter.x - static_cast<int>(round(width / 2))) - 3;
         int maxX = (patchRectCenter.x + static_cast<int>(round(width / 2))) + 3;
-        if ((minX >= 0) && (maxX < frame.cols))
+        if ((minX >= frameRegion.x) && (maxX < frameRegion.br().x))
         {
             widths.insert(width);
         }
@@ -70,7 +260,7 @@ void Classifier::trainPositive(const cv::Mat &frame, const cv::Rect &patchRect)
         int height = static_cast<int>(round(patchRect.height * scale));
         int minY = (patchRectCenter.y - static_cast<int>(round(height / 2))) - 3;
         int maxY = (patchRectCenter.y + static_cast<int>(round(height / 2))) + 3;
-        if ((minY >= 0) && (maxY < frame.rows))
+        if ((minY >= frameRegion.y) && (maxY < frameRegion.br().y))
         {
             heights.insert(height);
         }
@@ -84,31 +274,18 @@ void Classifier::trainPositive(const cv::Mat &frame, const cv::Rect &patchRect)
         for (maxAngle = 10.0; maxAngle >= 0.0; maxAngle -= 1.0)
         {
             warpFrameRect = cv::RotatedRect(patchRectCenter, warpFrameSize, maxAngle).boundingRect();
-            if ((warpFrameRect.tl().x >= 0)
-                && (warpFrameRect.tl().y >= 0)
-                && (warpFrameRect.br().x < frame.cols)
-                && (warpFrameRect.br().y < frame.rows))
+            if ((warpFrameRect.tl().x >= frameRegion.x)
+                && (warpFrameRect.tl().y >= frameRegion.y)
+                && (warpFrameRect.br().x < frameRegion.br().x)
+                && (warpFrameRect.br().y < frameRegion.br().y))
             {
                 break;
             }
         }
 
-        cv::Rect warpPatchRect((patchRect.x - warpFrameRect.x), (patchRect.y - warpFrameRect.y), patchRect.width, patchRect.height);
-        cv::Mat warpFrame = frame(warpFrameRect);
-        std::vector<double> angles;
-        for (double angle = -maxAngle; angle <= maxAngle; angle += 1.0)
-        {
-            angles.push_back(angle);
-        }
-
-        cv::Point2f warpPatchRectCenter = getRectCenter(warpPatchRect);
-        std::vector<cv::Mat> warpFrames(angles.size());
-        concurrent::blockingMapped(angles.begin(), angles.end(), warpFrames.begin(),
-                                   std::bind(&Classifier::transform, this, warpFrame, warpPatchRectCenter, std::placeholders::_1));
-
-        std::vector<cv::Rect> positivePatches;
-
-
+        /* Only the region covered by the positive patches is warped */
+        positivePatches.clear();
+        cv::Rect region;
         for (auto widthsIter = widths.begin(); widthsIter != widths.end(); ++widthsIter)
         {
             int width = *widthsIter;
@@ -119,62 +296,133 @@ void Classifier::trainPositive(const cv::Mat &frame, const cv::Rect &patchRect)
                 {
                     for (int yOffset = -1; yOffset <= 1; yOffset += 1)
                     {
-                        int x = warpPatchRectCenter.x - static_cast<int>(round(width / 2)) + xOffset;
-                        int y = warpPatchRectCenter.y - static_cast<int>(round(height / 2)) + yOffset;
+                        int x = patchRectCenter.x - static_cast<int>(round(width / 2)) + xOffset;
+                        int y = patchRectCenter.y - static_cast<int>(round(height / 2)) + yOffset;
                         cv::Rect testPatchRect(x, y, width, height);
-                        if ((testPatchRect.tl().x >= 0)
-                            && (testPatchRect.tl().y >= 0)
-                            && (testPatchRect.br().x < warpFrameRect.width)
-                            && (testPatchRect.br().y < warpFrameRect.height))
+                        if ((testPatchRect.tl().x >= warpFrameRect.tl().x)
+                            && (testPatchRect.tl().y >= warpFrameRect.tl().y)
+                            && (testPatchRect.br().x < warpFrameRect.br().x)
+                            && (testPatchRect.br().y < warpFrameRect.br().y))
                         {
-                            positivePatches.push_back(cv::Rect(x, y, width, height));
+                            region = ((positivePatches.empty() == true) ? testPatchRect : (region | testPatchRect));
+                            positivePatches.push_back(testPatchRect);
                         }
                     }
                 }
             }
         }
-        for (size_t i = 0; i < warpFrames.size(); ++i)
+        for (auto &rect: positivePatches)
+        {
+            rect -= region.tl();
+        }
+
+        int anglesCount = (2 * static_cast<int>(maxAngle)) + 1;
+        if (positiveWarps.size() != static_cast<size_t>(anglesCount))
         {
-            concurrent::blockingMap(positivePatches.begin(), positivePatches.end(),
-                                    std::bind(&Classifier::train, this, warpFrames.at(i), std::placeholders::_1, true));
+            positiveWarps.resize(anglesCount);
+            for (int i = 0; i < anglesCount; ++i)
+            {
+                positiveWarps[i].angle = i - maxAngle;
+                positiveWarps[i].alpha = cos(positiveWarps[i].angle * CV_PI / 180.0);
+                positiveWarps[i].beta = sin(positiveWarps[i].angle * CV_PI / 180.0);
+            }
+        }
+
+        /* A single job: every task warps one angle and trains all its patches */
+        if (positivePatches.empty() == false)
+        {
+            pool->parallelFor(positiveWarps.size(), [this, &frame, &patchRectCenter, &region](const size_t begin, const size_t end)
+            {
+                for (size_t i = begin; i < end; ++i)
+                {
+                    transform(frame, patchRectCenter, region, positiveWarps[i]);
+                    for (const auto &rect: positivePatches)
+                    {
+                        train(positiveWarps[i].integralFrame, rect, true);
+                    }
+                }
+            }, 1);
         }
     }
+    update();
 }
 
 
-cv::Mat Classifier::transform(const cv::Mat &frame, const cv::Point2f &center, const double angle) const
+void Classifier::transform(const cv::Mat &frame, const cv::Point2f &center, const cv::Rect &region, PositiveWarp &warp) const
 {
-    cv::Mat transformMatrix = cv::getRotationMatrix2D(center, angle, 1.0);
-    cv::Mat transformedFrame;
-    cv::warpAffine(frame, transformedFrame, transformMatrix, frame.size());
-    cv::Mat integralFrame;
-    cv::integral(transformedFrame, integralFrame);
-    return integralFrame;
+    TLD_TRACE_SCOPE("Classifier::transform");
+    /* cv::getRotationMatrix2D() moved to the region origin */
+    cv::Matx23d transformMatrix(warp.alpha, warp.beta, (((1.0 - warp.alpha) * center.x) - (warp.beta * center.y) - region.x),
+                                -warp.beta, warp.alpha, ((warp.beta * center.x) + ((1.0 - warp.alpha) * center.y) - region.y));
+    cv::warpAffine(frame, warp.warpedFrame, transformMatrix, region.size());
+    cv::integral(warp.warpedFrame, warp.integralFrame);
 }
 
 
-void Classifier::init(const cv::Mat &frame, const cv::Rect &patchRect)
+void Classifier::init(const FrameContext &context, const cv::Rect &patchRect)
 {
-    for (size_t fern = 0; fern < ferns.size(); ++fern)
+    reset();
+    train(context, patchRect, true);
+    trainPositive(context, patchRect);
+    trainNegative(context.getIntegral(), patchRect);
+}
+
+
+double Classifier::classify(const cv::Mat &frame, const cv::Rect &patchRect) const
+{
+    int sum = 0;
+    for (int fern = 0; fern < fernsCount; ++fern)
     {
-        ferns.at(fern)->reset();
+        sum += ferns[fern].getPosterior(frame, patchRect);
     }
-    cv::Mat integralFrame;
-    cv::integral(frame, integralFrame);
-    train(integralFrame, patchRect, true);
-    trainPositive(frame, patchRect);
-    trainNegative(integralFrame, patchRect);
+    return (static_cast<double>(sum) / (static_cast<double>(Fern::posteriorScale) * fernsCount));
 }
 
 
-double Classifier::classify(const cv::Mat &frame, const cv::Rect &patchRect) const
+double Classifier::classify(const FrameContext &context, const cv::Rect &patchRect) const
+{
+    return classify(context.getIntegral(), patchRect);
+}
+
+
+void Classifier::classify(const cv::Mat &frame, const cv::Rect *windows, const size_t windowsCount, double *confidences) const
+{
+    if (windowsCount == 0)
+    {
+        return;
+    }
+    int step = static_cast<int>(frame.step1());
+    std::vector<int> featureOffsets;
+    getFeatureOffsets(windows[0].size(), step, featureOffsets);
+    std::vector<int> windowOffsets(windowsCount);
+    for (size_t window = 0; window < windowsCount; ++window)
+    {
+        windowOffsets[window] = (windows[window].y * step) + windows[window].x;
+    }
+    classify(frame, featureOffsets.data(), windowOffsets.data(), windowsCount, confidences);
+}
+
+
+void Classifier::classify(const cv::Mat &frame, const int *featureOffsets, const int *windowOffsets, const size_t windowsCount,
+                          double *confidences) const
+{
+    std::vector<int> sums(windowsCount);
+    kernels::getPosteriorSums(frame.ptr<int>(), windowOffsets, windowsCount, featureOffsets,
+                              fernsCount, featuresCount, posteriors.data(), sums.data());
+    for (size_t window = 0; window < windowsCount; ++window)
+    {
+        confidences[window] = static_cast<double>(sums[window]) / (static_cast<double>(Fern::posteriorScale) * fernsCount);
+    }
+}
+
+
+void Classifier::getFeatureOffsets(const cv::Size &windowSize, const int step, std::vector<int> &offsets) const
 {
-    double sum = 0.0;
-    for (uint fern = 0; fern < ferns.size(); ++fern)
+    offsets.resize(features.size() * Feature::cornersCount);
+    for (size_t feature = 0; feature < features.size(); ++feature)
     {
-        sum += ferns.at(fern)->classify(frame, patchRect);
+        features[feature].getOffsets(windowSize, step, &(offsets[feature * Feature::cornersCount]));
     }
-    return (sum / ferns.size());
 }
 
 
@@ -190,6 +438,82 @@ double Classifier::getRectsOverlap(const cv::Rect &first, const cv::Rect &second
 }
 
 
+int Classifier::getFernsCount() const
+{
+    return fernsCount;
+}
+
+
+const Fern &Classifier::getFern(const int index) const
+{
+    return ferns.at(index);
+}
+
+
+void Classifier::save(snapshot::Writer &writer) const
+{
+    writer.write(fernsCount);
+    writer.write(featuresCount);
+    writer.align();
+    for (const auto &feature: features)
+    {
+        double scales[Feature::scalesCount];
+        feature.getScales(scales);
+        writer.writeArray(scales, Feature::scalesCount);
+    }
+    writer.align();
+    for (const auto &leaf: leafs)
+    {
+        writer.write(leaf.getCounters());
+    }
+    writer.align();
+    writer.writeArray(posteriors.data(), posteriors.size());
+}
+
+
+bool Classifier::readSnapshot(snapshot::Reader &reader, SnapshotTables &tables) const
+{
+    int savedFernsCount = 0;
+    int savedFeaturesCount = 0;
+    reader.read(savedFernsCount);
+    reader.read(savedFeaturesCount);
+    if ((reader.isValid() == false) || (savedFernsCount != fernsCount) || (savedFeaturesCount != featuresCount))
+    {
+        return false;
+    }
+    /* Only the positions of the tables are taken, they are copied by applySnapshot() */
+    reader.align();
+    const double *scales = reader.getTable<double>(features.size() * Feature::scalesCount);
+    reader.align();
+    const uint64_t *counters = reader.getTable<uint64_t>(leafs.size());
+    reader.align();
+    const uint16_t *savedPosteriors = reader.getTable<uint16_t>(posteriors.size());
+    if (reader.isValid() == false)
+    {
+        return false;
+    }
+    tables.scales = scales;
+    tables.counters = counters;
+    tables.posteriors = savedPosteriors;
+    return true;
+}
+
+
+void Classifier::applySnapshot(const SnapshotTables &tables)
+{
+    for (size_t feature = 0; feature < features.size(); ++feature)
+    {
+        features[feature].setScales(tables.scales + (feature * Feature::scalesCount));
+    }
+    for (size_t leaf = 0; leaf < leafs.size(); ++leaf)
+    {
+        leafs[leaf].setCounters(tables.counters[leaf]);
+    }
+    std::memcpy(posteriors.data(), tables.posteriors, (posteriors.size() * sizeof(uint16_t)));
+    touchedLeafsCount.store(0, std::memory_order_relaxed);
+}
+
+
 cv::Point2f Classifier::getRectCenter(const cv::Rect &rect) const
 {
     float x = static_cast<float>(round(rect.x + (rect.width / 2.0)));
@@ -2,33 +2,117 @@
 #define CLASSIFIER_HPP
 
 #include <vector>
+#include <algorithm>
 #include <cmath>
 #include <functional>
 #include <memory>
 #include <chrono>
 #include <set>
+#include <unordered_set>
+#include <numeric>
+#include <atomic>
+#include <cstdint>
 
 #include "Concurrent.hpp"
+#include "ThreadPool.hpp"
 #include "Fern.hpp"
+#include "Feature.hpp"
+#include "Leaf.hpp"
+#include "Kernels.hpp"
+#include "FrameContext.hpp"
+#include "Trace.hpp"
+#include "Snapshot.hpp"
 #include "Constants.hpp"
 
 
 class Classifier
 {
 public:
-    explicit Classifier(const int fernsCount, const int featuresCount, const double minFeatureScale, const double maxFeatureScale);
+    explicit Classifier(const int fernsCount, const int featuresCount, const double minFeatureScale, const double maxFeatureScale,
+                        std::shared_ptr<ThreadPool> &pool);
     ~Classifier() = default;
-    void init(const cv::Mat &frame, const cv::Rect &patchRect);
+    void init(const FrameContext &context, const cv::Rect &patchRect);
     void train(const cv::Mat &frame, const cv::Rect &patchRect, const bool isPositive);
+    void train(const FrameContext &context, const cv::Rect &patchRect, const bool isPositive);
+    /* Publishes the posteriors of the leafs trained since the last call */
+    void update();
     double classify(const cv::Mat &frame, const cv::Rect &patchRect) const;
+    double classify(const FrameContext &context, const cv::Rect &patchRect) const;
+    /* Confidences of windowsCount windows of the same size */
+    void classify(const cv::Mat &frame, const cv::Rect *windows, const size_t windowsCount, double *confidences) const;
+    /* The same with the offsets of getFeatureOffsets() and the windows top-left corners as frame offsets */
+    void classify(const cv::Mat &frame, const int *featureOffsets, const int *windowOffsets, const size_t windowsCount,
+                  double *confidences) const;
+    /* Feature::cornersCount offsets per feature, fern-major */
+    void getFeatureOffsets(const cv::Size &windowSize, const int step, std::vector<int> &offsets) const;
     double getRectsOverlap(const cv::Rect &first, const cv::Rect &second) const;
     cv::Point2f getRectCenter(const cv::Rect &rect) const;
-    void trainPositive(const cv::Mat &frame, const cv::Rect &patchRect);
+    void trainPositive(const FrameContext &context, const cv::Rect &patchRect);
+    void trainNegative(const cv::Mat &frame, const cv::Rect &patchRect);
+    /* About limit negative windows per trainNegative() call, picked evenly
+     * over the scales and the frame; 0 keeps all of them */
+    void setNegativeSamplesLimit(const size_t limit);
+    /* Trains the hardest of the negative candidates (the highest confidences)
+     * up to the budget, candidates with the leafs of an already chosen one in
+     * every fern are skipped. Returns the count of the trained negatives,
+     * the posteriors are published by update(). */
+    size_t trainHardNegatives(const cv::Mat &frame, const std::vector<cv::Rect> &rects,
+                              const std::vector<double> &confidences);
+    void setHardNegativesBudget(const size_t budget);
+    int getFernsCount() const;
+    const Fern &getFern(const int index) const;
+    /* Tables of a snapshot, they point into the data of the reader */
+    struct SnapshotTables
+    {
+        const double *scales;
+        const uint64_t *counters;
+        const uint16_t *posteriors;
+    };
+    /* Features geometry, leaf counters and posteriors. readSnapshot() changes
+     * nothing and returns false when the ferns do not match or the tables are
+     * truncated, applySnapshot() copies the tables while the data is alive. */
+    void save(snapshot::Writer &writer) const;
+    bool readSnapshot(snapshot::Reader &reader, SnapshotTables &tables) const;
+    void applySnapshot(const SnapshotTables &tables);
 
 private:
-    std::vector<std::shared_ptr<Fern>> ferns;
-    void trainNegative(const cv::Mat &frame, const cv::Rect &patchRect);
-    cv::Mat transform(const cv::Mat &frame, const cv::Point2f &center, const double angle) const;
+    /* Buffers of one rotation of trainPositive(), kept across the frames */
+    struct PositiveWarp
+    {
+        double angle;
+        double alpha;
+        double beta;
+        cv::Mat warpedFrame;
+        cv::Mat integralFrame;
+    };
+
+    int fernsCount;
+    int featuresCount;
+    int leafsCount;
+    /* Fern-major tables: featuresCount features and leafsCount leafs per fern,
+     * posteriors has one padding element for the SIMD gathers */
+    std::vector<Feature> features;
+    std::vector<Leaf> leafs;
+    std::vector<uint16_t> posteriors;
+    std::vector<Fern> ferns;
+    std::vector<int> touchedLeafs;
+    std::atomic<int> touchedLeafsCount;
+    std::shared_ptr<ThreadPool> pool;
+    size_t negativeSamplesLimit;
+    size_t hardNegativesBudget;
+    /* Buffers of trainHardNegatives() */
+    std::vector<size_t> hardNegativesOrder;
+    std::vector<int> hardNegativesLeafs;
+    std::unordered_set<uint64_t> hardNegativesCodes;
+    /* Buffers of trainNegative() */
+    std::vector<int> negativeOffsets;
+    std::vector<int> negativeFeatureOffsets;
+    std::vector<int> negativeLeafIndices;
+    std::vector<PositiveWarp> positiveWarps;
+    std::vector<cv::Rect> positivePatches;
+    void reset();
+    /* Rotates frame around center into the region sized buffers of warp */
+    void transform(const cv::Mat &frame, const cv::Point2f &center, const cv::Rect &region, PositiveWarp &warp) const;
 };
 
 #endif /* CLASSIFIER_HPP */
@@ -10,6 +10,10 @@ const double negativeConfidence = 0.7;
 const double detectionConfidence = 0.9;
 const double minimumOverlap = 0.6;
 const double conformityOverlap = 0.8;
+const double redetectionConfidence = 0.85;
+const double verificationSimilarity = 0.6;
+const double positiveSimilarity = 0.65;
+const double negativeSimilarity = 0.5;
 
 
 #endif /* CONSTANTS_HPP */
@@ -1,35 +1,152 @@
 #include "Detector.hpp"
-#include <iostream>
 
 
-Detector::Detector(std::shared_ptr<Classifier> &classifier)
-: classifier(classifier), patchRectWidth(0), patchRectHeight(0), varianceThreshold(0),
+namespace
+{
+void writeRect(snapshot::Writer &writer, const cv::Rect &rect)
+{
+    int values[4] = {rect.x, rect.y, rect.width, rect.height};
+    writer.writeArray(values, 4);
+}
+
+cv::Rect readRect(snapshot::Reader &reader)
+{
+    int values[4] = {0, 0, 0, 0};
+    reader.readArray(values, 4);
+    return cv::Rect(values[0], values[1], values[2], values[3]);
+}
+}
+
+
+Detector::Detector(std::shared_ptr<Classifier> &classifier, std::shared_ptr<ThreadPool> &pool)
+: classifier(classifier), pool(pool), patchRectWidth(0), patchRectHeight(0), varianceThreshold(0),
   frameWidth(0), frameHeight(0), minSideSize(16), maxSideSize(120),
-  failureCounter(0), failureScaleFactor(0) {}
+  failureCounter(0), failureScaleFactor(0), isRedetectionEnabled(false), redetectionBudget(200000),
+  redetectionCursor(0) {}
 
 
-void Detector::init(const cv::Mat &frame, const cv::Rect &patchRect)
+void Detector::init(const FrameContext &context, const cv::Rect &patchRect)
 {
-    frameWidth = frame.cols;
-    frameHeight = frame.rows;
+    frameWidth = context.getWidth();
+    frameHeight = context.getHeight();
     lastPatchRect = patchRect;
+    predictedPatchRect = cv::Rect(0, 0, 0, 0);
     failureCounter = 0;
     filter.reset();
-    setVarianceThreshold(frame, patchRect);
-    std::cout << frameWidth << "; " << frameHeight << std::endl;
+    setVarianceThreshold(context, patchRect);
+}
+
+
+const DetectorStatistics &Detector::getStatistics() const
+{
+    return statistics;
+}
+
+
+void Detector::setRedetection(const bool isEnabled)
+{
+    isRedetectionEnabled = isEnabled;
+}
+
+
+bool Detector::isRedetecting() const
+{
+    return isRedetectionEnabled;
+}
+
+
+void Detector::setRedetectionBudget(const size_t windowsPerFrame)
+{
+    redetectionBudget = std::max<size_t>(1, windowsPerFrame);
+}
+
+
+void Detector::setVerifier(std::shared_ptr<NNClassifier> verifier)
+{
+    this->verifier = verifier;
 }
 
 
-void Detector::setVarianceThreshold(const cv::Mat &frame, const cv::Rect &patchRect)
+cv::Rect Detector::getSearchRegion(const cv::Rect &patchRect) const
 {
-    cv::Mat integralFrame;
-    cv::Mat squareIntegralFrame;
-    cv::integral(frame, integralFrame, squareIntegralFrame);
+    /* detect() centers the scan at the patch when it is close to the last
+     * patch size and at the last patch otherwise, the largest window is 1.05
+     * of that size and the failure counter may grow by one on the way */
+    int failureFactor = std::max(((failureCounter + 1) / 20), 1) + 1;
+    cv::Rect region(0, 0, 0, 0);
+    for (const cv::Rect &rect: {patchRect, lastPatchRect})
+    {
+        if (rect.area() > 0)
+        {
+            int width = static_cast<int>(ceil(rect.width * 1.05)) * failureFactor;
+            int height = static_cast<int>(ceil(rect.height * 1.05)) * failureFactor;
+            cv::Point2f center = classifier->getRectCenter(rect);
+            cv::Rect searchRect((static_cast<int>(center.x) - (width / 2) - 1), (static_cast<int>(center.y) - (height / 2) - 1),
+                                (width + 2), (height + 2));
+            region = ((region.area() == 0) ? searchRect : (region | searchRect));
+        }
+    }
+    return region;
+}
+
+
+cv::Rect Detector::getPredictedRect() const
+{
+    return predictedPatchRect;
+}
+
+
+void Detector::setVarianceThreshold(const FrameContext &context, const cv::Rect &patchRect)
+{
+    const cv::Mat &squareIntegralFrame = context.getSquareIntegral();
+    const cv::Mat &integralFrame = context.getIntegral();
     varianceThreshold = getPatchVariance(integralFrame, squareIntegralFrame, patchRect) / 2.0;
 }
 
 
-cv::Rect Detector::getCurrentPatchRect(const cv::Rect &patchRect)
+void Detector::save(snapshot::Writer &writer) const
+{
+    writer.write(frameWidth);
+    writer.write(frameHeight);
+    writeRect(writer, lastPatchRect);
+    writeRect(writer, predictedPatchRect);
+    writer.write(varianceThreshold);
+    writer.write(failureCounter);
+    filter.save(writer);
+}
+
+
+bool Detector::readSnapshot(snapshot::Reader &reader, SnapshotState &state) const
+{
+    state.frameWidth = 0;
+    state.frameHeight = 0;
+    state.varianceThreshold = 0.0;
+    state.failureCounter = 0;
+    reader.read(state.frameWidth);
+    reader.read(state.frameHeight);
+    state.lastPatchRect = readRect(reader);
+    state.predictedPatchRect = readRect(reader);
+    reader.read(state.varianceThreshold);
+    reader.read(state.failureCounter);
+    return ((reader.isValid() == true) && (state.filter.load(reader) == true));
+}
+
+
+void Detector::applySnapshot(const SnapshotState &state)
+{
+    /* The scan grid caches feature offsets of the features the snapshot replaced */
+    grid.reset();
+    frameWidth = state.frameWidth;
+    frameHeight = state.frameHeight;
+    lastPatchRect = state.lastPatchRect;
+    predictedPatchRect = state.predictedPatchRect;
+    varianceThreshold = state.varianceThreshold;
+    failureCounter = state.failureCounter;
+    filter = state.filter;
+}
+
+
+cv::Rect Detector::getCurrentPatchRect(const cv::Rect &patchRect, const double timestamp)
 {
     cv::Rect currentPatchRect(0, 0, 0, 0);
 
@@ -43,8 +160,6 @@ cv::Rect Detector::getCurrentPatchRect(const cv::Rect &patchRect)
     }
     else
     {
-        std::cout << "====== patchRect = (" << patchRect.x << ", " << patchRect.y
-            << ", " << patchRect.width << ", " << patchRect.height << ")" << std::endl;
         ++failureCounter;
     }
 
@@ -68,13 +183,8 @@ cv::Rect Detector::getCurrentPatchRect(const cv::Rect &patchRect)
         currentPatchRect = lastPatchRect;
     }
 
-    predictedPatchRect = filter.predict(currentPatchRect);
-    std::cout << ">>> patchRect = (" << patchRect.x << ", " << patchRect.y << ", "
-        << patchRect.width << ", " << patchRect.height << ")" << std::endl;
-    std::cout << ">>> currentPatchRect = (" << currentPatchRect.x << ", " << currentPatchRect.y << ", "
-        << currentPatchRect.width << ", " << currentPatchRect.height << ")" << std::endl;
-    std::cout << ">>> predictedPatchRect = (" << predictedPatchRect.x << ", " << predictedPatchRect.y << ", "
-        << predictedPatchRect.width << ", " << predictedPatchRect.height << ")" << std::endl;
+    predictedPatchRect = filter.predict(currentPatchRect, timestamp);
+    TLD_TRACE_COUNTER("Detector::failures", failureCounter);
     if ((currentPatchRect.area() == 0)
         && (predictedPatchRect.width >= (lastPatchRect.width * 0.95))
         && (predictedPatchRect.width <= (lastPatchRect.width * 1.05))
@@ -92,130 +202,270 @@ cv::Rect Detector::getCurrentPatchRect(const cv::Rect &patchRect)
 }
 
 
-void Detector::detect(const cv::Mat &frame, const cv::Rect &patchRect, std::vector<Patch> &patches)
+void Detector::detect(const FrameContext &context, const cv::Rect &patchRect, std::vector<Patch> &patches)
 {
-    std::cout << "***Detector***" << std::endl;
-    std::cout << "failureScaleFactor = " << failureScaleFactor << std::endl;
-    auto start = std::chrono::high_resolution_clock::now();
+    TLD_TRACE_SCOPE("Detector::detect");
+    TLD_TRACE_BEGIN("Detector::windows");
+    cv::Rect currentPatchRect = getCurrentPatchRect(patchRect, context.getTimestamp());
+    currentPatchRectCenter = classifier->getRectCenter(currentPatchRect);
+    predictedPatchRectCenter = classifier->getRectCenter(predictedPatchRect);
 
-    cv::Rect currentPatchRect = getCurrentPatchRect(patchRect);
+    const cv::Mat &squareIntegralFrame = context.getSquareIntegral();
+    const cv::Mat &integralFrame = context.getIntegral();
+    const int *integralData = integralFrame.ptr<int>();
+    const double *squareIntegralData = squareIntegralFrame.ptr<double>();
+    int step = static_cast<int>(integralFrame.step1());
+    int squareStep = static_cast<int>(squareIntegralFrame.step1());
+    if (grid.update(*classifier, lastPatchRect.size(), cv::Size(frameWidth, frameHeight), step, squareStep) == true)
+    {
+        redetectionTiles.clear();
+    }
+    const std::vector<ScanScale> &scales = grid.getScales();
+    const cv::Rect &region = context.getRegion();
 
-    std::set<int> widths;
-    std::set<int> heights;
+    testRects.clear();
+    windowOffsets.clear();
+    windowScales.clear();
+    statistics = DetectorStatistics();
+    failureScaleFactor = std::max((failureCounter / 20), 1);
+    for (size_t scaleIndex = 0; scaleIndex < scales.size(); ++scaleIndex)
+    {
+        const ScanScale &scale = scales[scaleIndex];
+        int currentWidth = scale.size.width;
+        int currentHeight = scale.size.height;
+        int halfWidth = static_cast<int>(round(currentWidth / 2.0));
+        int halfHeight = static_cast<int>(round(currentHeight / 2.0));
+        int xCurrent = currentPatchRectCenter.x - halfWidth;
+        int yCurrent = currentPatchRectCenter.y - halfHeight;
+        /* The windows stay inside the region the context computed */
+        int xMin = std::max((xCurrent - (halfWidth * failureScaleFactor)), region.x);
+        int xMax = std::min(std::min((frameWidth - halfWidth), (xCurrent + (halfWidth * failureScaleFactor))),
+                            ((region.x + region.width) - currentWidth + 1));
+        int yMin = std::max((yCurrent - (halfHeight * failureScaleFactor)), region.y);
+        int yMax = std::min(std::min((frameHeight - halfHeight), (yCurrent + (halfHeight * failureScaleFactor))),
+                            ((region.y + region.height) - currentHeight + 1));
+        double area = static_cast<double>(scale.size.area());
+        /* The variance stage drops the flat windows before they are stored */
+        for (int x = xMin; x < xMax; x += scale.xStep)
+        {
+            for (int y = yMin; y < yMax; y += scale.yStep)
+            {
+                ++statistics.windows;
+                int offset = (y * step) + x;
+                const int *corners = integralData + offset;
+                const double *squareCorners = squareIntegralData + (y * squareStep) + x;
+                double mean = (corners[scale.cornerOffsets[0]] + corners[scale.cornerOffsets[3]]
+                    - corners[scale.cornerOffsets[1]] - corners[scale.cornerOffsets[2]]) / area;
+                double deviance = (squareCorners[scale.squareCornerOffsets[0]] + squareCorners[scale.squareCornerOffsets[3]]
+                    - squareCorners[scale.squareCornerOffsets[1]] - squareCorners[scale.squareCornerOffsets[2]]) / area;
+                if ((deviance - (mean * mean)) > varianceThreshold)
+                {
+                    testRects.push_back(cv::Rect(x, y, currentWidth, currentHeight));
+                    windowOffsets.push_back(offset);
+                    windowScales.push_back(scaleIndex);
+                }
+            }
+        }
+    }
+    statistics.varianceAccepted = testRects.size();
+    TLD_TRACE_END("Detector::windows");
+    TLD_TRACE_COUNTER("Detector::windows", statistics.windows);
+    TLD_TRACE_COUNTER("Detector::varianceAccepted", statistics.varianceAccepted);
 
-    double minScale = 0.95;
-    double maxScale = 1.05;
-    double scaleStep = 0.05;
+    TLD_TRACE_BEGIN("Detector::classification");
+    confidences.resize(testRects.size());
+    pool->parallelFor(testRects.size(), [&](const size_t begin, const size_t end)
+    {
+        TLD_TRACE_SCOPE("Detector::classify");
+        for (size_t first = begin; first < end;)
+        {
+            size_t last = first + 1;
+            while ((last < end) && (windowScales[last] == windowScales[first]))
+            {
+                ++last;
+            }
+            classifier->classify(integralFrame, scales[windowScales[first]].featureOffsets.data(), &(windowOffsets[first]),
+                                 (last - first), &(confidences[first]));
+            first = last;
+        }
+    });
+    TLD_TRACE_END("Detector::classification");
+
+    TLD_TRACE_BEGIN("Detector::filtering");
+    patches.clear();
+    for (size_t i = 0; i < testRects.size(); ++i)
+    {
+        Patch patch = getPatch(testRects[i], confidences[i], currentPatchRect);
+        if (checkPatchConformity(patch) == true)
+        {
+            patches.push_back(patch);
+        }
+    }
+    TLD_TRACE_END("Detector::filtering");
+    /* The tiles span the whole frame */
+    if ((isRedetectionEnabled == true) && (context.isWholeFrame() == true))
+    {
+        redetect(integralFrame, squareIntegralFrame, currentPatchRect, patches);
+    }
+    statistics.ensembleAccepted = patches.size();
+    TLD_TRACE_COUNTER("Detector::ensembleAccepted", statistics.ensembleAccepted);
+    if ((verifier != nullptr) && (verifier->getPositivesCount() > 0))
+    {
+        verify(context.getFrame(), patches);
+    }
+    statistics.verifierAccepted = patches.size();
+    //    patches.push_back(Patch(predictedPatchRect, 0, false));
+}
 
-//    if ((currentPatchRect.x != patchRect.x)
-//        || (currentPatchRect.y != patchRect.y)
-//        || (currentPatchRect.width != patchRect.width)
-//        || (currentPatchRect.height != patchRect.height))
-//    {
-//        minScale = 0.9;
-//        maxScale = 1.1;
-//    }
 
-    for (double scale = minScale; scale <= maxScale; scale += scaleStep)
+void Detector::verify(const cv::Mat &frame, std::vector<Patch> &patches)
+{
+    TLD_TRACE_SCOPE("Detector::verification");
+    verifiedPatches.clear();
+    for (size_t i = 0; i < patches.size(); ++i)
     {
-        widths.insert(static_cast<int>(round(lastPatchRect.width * scale)));
-        heights.insert(static_cast<int>(round(lastPatchRect.height * scale)));
+        if (patches[i].confidence >= negativeConfidence)
+        {
+            verifiedPatches.push_back(i);
+        }
+    }
+    similarities.resize(verifiedPatches.size());
+    pool->parallelFor(verifiedPatches.size(), [&](const size_t begin, const size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            similarities[i] = verifier->classify(frame, patches[verifiedPatches[i]].rect);
+        }
+    });
+    /* Drops the rejected ones keeping the order */
+    size_t kept = 0;
+    size_t verified = 0;
+    for (size_t i = 0; i < patches.size(); ++i)
+    {
+        if ((verified < verifiedPatches.size()) && (verifiedPatches[verified] == i))
+        {
+            if (similarities[verified++] <= verificationSimilarity)
+            {
+                continue;
+            }
+        }
+        patches[kept++] = patches[i];
     }
+    patches.resize(kept);
+    TLD_TRACE_COUNTER("Detector::verifierAccepted", kept);
+}
 
-    double stepDevider = 20.0;
-    currentPatchRectCenter = classifier->getRectCenter(currentPatchRect);
-    predictedPatchRectCenter = classifier->getRectCenter(predictedPatchRect);
 
-    cv::Mat integralFrame;
-    cv::Mat squareIntegralFrame;
-    cv::integral(frame, integralFrame, squareIntegralFrame);
-    //    int xStart = std::max((currentPatchRectCenter.x - (currentPatchRect.width / 2) - currentPatchRect.width), 0);
-    //    int yStart = std::max((currentPatchRectCenter.y - (currentPatchRect.height / 2) - currentPatchRect.height), 0);
-    //    int xStop = std::min((frameWidth - currentPatchRect.width),
-    //                         (currentPatchRectCenter.x - (currentPatchRect.width / 2) + currentPatchRect.width));
-    //    int yStop = std::min((frameHeight - currentPatchRect.height),
-    //                         (currentPatchRectCenter.y - (currentPatchRect.height / 2) + currentPatchRect.height));
-    //    varianceThreshold = getPatchVariance(integralFrame, squareIntegralFrame,
-    //                                         cv::Rect(xStart, yStart, (xStop - xStart), (yStop - yStart)));
-
-    std::vector<cv::Rect> testRects;
-    failureScaleFactor = std::max((failureCounter / 20), 1);
-    for (auto widthIterator = widths.begin(); widthIterator != widths.end(); ++widthIterator)
+void Detector::buildRedetectionTiles()
+{
+    /* About tileWindows windows per tile, whole rows of windows */
+    const size_t tileWindows = 4096;
+    const std::vector<ScanScale> &scales = grid.getScales();
+    redetectionTiles.clear();
+    redetectionCursor = 0;
+    for (size_t scaleIndex = 0; scaleIndex < scales.size(); ++scaleIndex)
     {
-        int currentWidth = (*widthIterator);
-        int xStep = static_cast<int>(round(currentWidth / stepDevider));
-        int xCurrent;
-        int xMin;
-        int xMax;
-        if (failureCounter == 0)
+        const ScanScale &scale = scales[scaleIndex];
+        if ((scale.size.width > frameWidth) || (scale.size.height > frameHeight))
         {
-            xCurrent = currentPatchRectCenter.x - (static_cast<int>(round(currentWidth / 2.0)));
-            xMin = std::max((xCurrent - static_cast<int>(round(currentWidth / 2.0))), 0);
-            xMax = std::min((frameWidth - static_cast<int>(round(currentWidth / 2.0))),
-                            (xCurrent + static_cast<int>(round(currentWidth / 2.0))));
+            continue;
         }
-        else
+        int columns = ((frameWidth - scale.size.width) / scale.xStep) + 1;
+        int rows = ((frameHeight - scale.size.height) / scale.yStep) + 1;
+        int tileRows = std::max(1, static_cast<int>(tileWindows / columns));
+        for (int row = 0; row < rows; row += tileRows)
         {
-            //            xCurrent = ((currentPatchRectCenter.x + predictedPatchRectCenter.x) / 2) - (currentWidth / 2);
-            xCurrent = currentPatchRectCenter.x - (static_cast<int>(round(currentWidth / 2.0)));
-            xMin = std::max((xCurrent - (static_cast<int>(round(currentWidth / 2.0)) * failureScaleFactor)), 0);
-            xMax = std::min((frameWidth - static_cast<int>(round(currentWidth / 2.0))),
-                            (xCurrent + (static_cast<int>(round(currentWidth / 2.0)) * failureScaleFactor)));
+            RedetectionTile tile;
+            tile.scaleIndex = scaleIndex;
+            tile.yBegin = row * scale.yStep;
+            tile.yEnd = std::min(rows, (row + tileRows)) * scale.yStep;
+            tile.windowsCount = static_cast<size_t>(std::min(tileRows, (rows - row))) * columns;
+            redetectionTiles.push_back(tile);
         }
-        for (int x = xMin; x < xMax; x += xStep)
+    }
+}
+
+
+void Detector::redetect(const cv::Mat &integralFrame, const cv::Mat &squareIntegralFrame, const cv::Rect &patchRect,
+                        std::vector<Patch> &patches)
+{
+    TLD_TRACE_SCOPE("Detector::redetect");
+    if (redetectionTiles.empty() == true)
+    {
+        buildRedetectionTiles();
+        if (redetectionTiles.empty() == true)
         {
-            for (auto heightIterator = heights.begin(); heightIterator != heights.end(); ++heightIterator)
+            return;
+        }
+    }
+    /* The next tiles within the budget, at least one */
+    size_t first = redetectionCursor;
+    size_t tilesCount = 0;
+    size_t windowsCount = 0;
+    while ((tilesCount < redetectionTiles.size())
+           && ((tilesCount == 0) || ((windowsCount + redetectionTiles[(first + tilesCount) % redetectionTiles.size()].windowsCount)
+                                     <= redetectionBudget)))
+    {
+        windowsCount += redetectionTiles[(first + tilesCount) % redetectionTiles.size()].windowsCount;
+        ++tilesCount;
+    }
+    redetectionCursor = (first + tilesCount) % redetectionTiles.size();
+
+    const std::vector<ScanScale> &scales = grid.getScales();
+    const int *integralData = integralFrame.ptr<int>();
+    const double *squareIntegralData = squareIntegralFrame.ptr<double>();
+    int step = static_cast<int>(integralFrame.step1());
+    int squareStep = static_cast<int>(squareIntegralFrame.step1());
+    pool->parallelFor(tilesCount, [&](const size_t begin, const size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            TLD_TRACE_SCOPE("Detector::tile");
+            RedetectionTile &tile = redetectionTiles[(first + i) % redetectionTiles.size()];
+            const ScanScale &scale = scales[tile.scaleIndex];
+            double area = static_cast<double>(scale.size.area());
+            tile.windowOffsets.clear();
+            for (int y = tile.yBegin; y < tile.yEnd; y += scale.yStep)
             {
-                int currentHeight = (*heightIterator);
-                int yStep = static_cast<int>(round(currentHeight / stepDevider));
-                int yCurrent;
-                int yMin;
-                int yMax;
-                if (failureCounter == 0)
-                {
-                    yCurrent = currentPatchRectCenter.y - (static_cast<int>(round(currentHeight / 2.0)));
-                    yMin = std::max((yCurrent - static_cast<int>(round(currentHeight / 2.0))), 0);
-                    yMax = std::min((frameHeight - static_cast<int>(round(currentHeight / 2.0))),
-                                    (yCurrent + static_cast<int>(round(currentHeight / 2.0))));
-                }
-                else
-                {
-                    //                    yCurrent = ((currentPatchRectCenter.y + predictedPatchRectCenter.y) / 2) - (currentHeight / 2);
-                    yCurrent = currentPatchRectCenter.y - (static_cast<int>(round(currentHeight / 2.0)));
-                    yMin = std::max((yCurrent - (static_cast<int>(round(currentHeight / 2.0)) * failureScaleFactor)), 0);
-                    yMax = std::min((frameHeight - static_cast<int>(round(currentHeight / 2.0))),
-                                    (yCurrent + (static_cast<int>(round(currentHeight / 2.0)) * failureScaleFactor)));
-                }
-//                std::cout << "xMin = " << xMin << "; xMax = " << xMax + currentWidth
-//                    << "; yMin = " << yMin << "; yMax = " << yMax + currentHeight << std::endl;
-                for (int y = yMin; y < yMax; y += yStep)
+                for (int x = 0; (x + scale.size.width) <= frameWidth; x += scale.xStep)
                 {
-                    testRects.push_back(cv::Rect(x, y, currentWidth, currentHeight));
+                    int offset = (y * step) + x;
+                    const int *corners = integralData + offset;
+                    const double *squareCorners = squareIntegralData + (y * squareStep) + x;
+                    double mean = (corners[scale.cornerOffsets[0]] + corners[scale.cornerOffsets[3]]
+                        - corners[scale.cornerOffsets[1]] - corners[scale.cornerOffsets[2]]) / area;
+                    double deviance = (squareCorners[scale.squareCornerOffsets[0]] + squareCorners[scale.squareCornerOffsets[3]]
+                        - squareCorners[scale.squareCornerOffsets[1]] - squareCorners[scale.squareCornerOffsets[2]]) / area;
+                    if ((deviance - (mean * mean)) > varianceThreshold)
+                    {
+                        tile.windowOffsets.push_back(offset);
+                    }
                 }
             }
+            tile.confidences.resize(tile.windowOffsets.size());
+            classifier->classify(integralFrame, scale.featureOffsets.data(), tile.windowOffsets.data(),
+                                 tile.windowOffsets.size(), tile.confidences.data());
         }
-    }
-    std::cout << "testRects.size() = " << testRects.size() << std::endl;
-    //    auto end = concurrent::blockingFilter(testRects.begin(), testRects.end(),
-    //                                          std::bind(&Detector::checkPatchVariace, this,
-    //                                                    integralFrame, squareIntegralFrame, std::placeholders::_1));
-    //    testRects.erase(end, testRects.end());
-    //    std::cout << "testRects.size() = " << testRects.size() << std::endl;
-    patches.resize(testRects.size());
-    concurrent::blockingMapped(testRects.begin(), testRects.end(), patches.begin(),
-                               std::bind(&Detector::getPatch, this, std::placeholders::_1, integralFrame, currentPatchRect));
-    std::cout << "patches.size() = " << patches.size() << std::endl;
-    if (patches.size() > 0)
+    }, 1);
+
+    for (size_t i = 0; i < tilesCount; ++i)
     {
-        auto end = concurrent::blockingFilter(patches.begin(), patches.end(),
-                                              std::bind(&Detector::checkPatchConformity, this, std::placeholders::_1));
-        patches.erase(end, patches.end());
+        const RedetectionTile &tile = redetectionTiles[(first + i) % redetectionTiles.size()];
+        const cv::Size &size = scales[tile.scaleIndex].size;
+        statistics.varianceAccepted += tile.windowOffsets.size();
+        for (size_t window = 0; window < tile.windowOffsets.size(); ++window)
+        {
+            cv::Rect testRect((tile.windowOffsets[window] % step), (tile.windowOffsets[window] / step), size.width, size.height);
+            Patch patch = getPatch(testRect, tile.confidences[window], patchRect);
+            if (checkPatchConformity(patch) == true)
+            {
+                patches.push_back(patch);
+            }
+        }
     }
-    auto stop = std::chrono::high_resolution_clock::now();
-    std::cout << "patches.size() = " << patches.size() << std::endl;
-    std::cout << "Detector elapsed = " << std::chrono::duration_cast<std::chrono::milliseconds>(stop - start).count() << std::endl;
-    std::cout << "***Detector***\n" << std::endl;
-    //    patches.push_back(Patch(predictedPatchRect, 0, false));
+    statistics.windows += windowsCount;
+    statistics.redetectionWindows = windowsCount;
+    TLD_TRACE_COUNTER("Detector::redetectionWindows", windowsCount);
 }
 
 
@@ -239,9 +489,8 @@ double Detector::getPatchVariance(const cv::Mat &integralFrame, const cv::Mat &s
 }
 
 
-Patch Detector::getPatch(const cv::Rect &testRect, const cv::Mat &frame, const cv::Rect &patchRect) const
+Patch Detector::getPatch(const cv::Rect &testRect, const double confidence, const cv::Rect &patchRect) const
 {
-    double confidence = classifier->classify(frame, testRect);
     double overlap = 0.0;
     if (patchRect.area() > 0)
     {
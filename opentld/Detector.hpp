@@ -13,23 +13,91 @@
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "Classifier.hpp"
+#include "NNClassifier.hpp"
 #include "Patch.hpp"
+#include "ScanGrid.hpp"
+#include "FrameContext.hpp"
 #include "Concurrent.hpp"
+#include "ThreadPool.hpp"
 #include "KalmanFilter.hpp"
+#include "Trace.hpp"
+#include "Snapshot.hpp"
 #include "Constants.hpp"
 
 
+/* Windows entering and leaving the cascade stages during the last detect() */
+struct DetectorStatistics
+{
+    DetectorStatistics()
+        : windows(0), redetectionWindows(0), varianceAccepted(0), ensembleAccepted(0), verifierAccepted(0) {}
+    /* Scanned windows, the input of the variance stage */
+    size_t windows;
+    /* Part of the windows scanned by the full-frame re-detection */
+    size_t redetectionWindows;
+    /* Output of the variance stage and input of the fern ensemble */
+    size_t varianceAccepted;
+    /* Output of the fern ensemble (confidence or overlap conformity) */
+    size_t ensembleAccepted;
+    /* Output of the nearest neighbor verifier, the detector output */
+    size_t verifierAccepted;
+};
+
+
 class Detector
 {
 public:
-    explicit Detector(std::shared_ptr<Classifier> &classifier);
+    explicit Detector(std::shared_ptr<Classifier> &classifier, std::shared_ptr<ThreadPool> &pool);
     ~Detector() = default;
-    void detect(const cv::Mat &frame, const cv::Rect &patchRect, std::vector<Patch> &patches);
-    void init(const cv::Mat &frame, const cv::Rect &patchRect);
-    void setVarianceThreshold(const cv::Mat &frame, const cv::Rect &patchRect);
+    void detect(const FrameContext &context, const cv::Rect &patchRect, std::vector<Patch> &patches);
+    void init(const FrameContext &context, const cv::Rect &patchRect);
+    void setVarianceThreshold(const FrameContext &context, const cv::Rect &patchRect);
+    const DetectorStatistics &getStatistics() const;
+    /* While enabled every detect() also scans the next tiles of the whole
+     * frame at all the grid scales, at most the budget of windows per call.
+     * The scan continues where the previous call stopped and wraps around,
+     * so a lost target is found within a few frames anywhere in the frame. */
+    void setRedetection(const bool isEnabled);
+    bool isRedetecting() const;
+    void setRedetectionBudget(const size_t windowsPerFrame);
+    /* Optional last stage: the patches confident enough to be detections
+     * (at least negativeConfidence) stay only with a relative similarity
+     * above verificationSimilarity, the others are left for the learning */
+    void setVerifier(std::shared_ptr<NNClassifier> verifier);
+    /* Bounds of the windows the next detect() may scan around the patch,
+     * the windows are also kept inside the context region */
+    cv::Rect getSearchRegion(const cv::Rect &patchRect) const;
+    /* Prediction of the Kalman filter for the frame of the last detect() */
+    cv::Rect getPredictedRect() const;
+    /* Frame geometry, last patch, variance threshold and the Kalman filter */
+    struct SnapshotState
+    {
+        int frameWidth;
+        int frameHeight;
+        cv::Rect lastPatchRect;
+        cv::Rect predictedPatchRect;
+        double varianceThreshold;
+        int failureCounter;
+        KalmanFilter filter;
+    };
+    /* readSnapshot() changes nothing and returns false for a truncated snapshot */
+    void save(snapshot::Writer &writer) const;
+    bool readSnapshot(snapshot::Reader &reader, SnapshotState &state) const;
+    void applySnapshot(const SnapshotState &state);
 
 private:
+    /* Band of window rows of one grid scale, scanned by one task */
+    struct RedetectionTile
+    {
+        size_t scaleIndex;
+        int yBegin;
+        int yEnd;
+        size_t windowsCount;
+        std::vector<int> windowOffsets;
+        std::vector<double> confidences;
+    };
+
     std::shared_ptr<Classifier> classifier;
+    std::shared_ptr<ThreadPool> pool;
     int patchRectWidth;
     int patchRectHeight;
     double varianceThreshold;
@@ -44,12 +112,30 @@ private:
     int failureScaleFactor;
     cv::Point currentPatchRectCenter;
     cv::Point predictedPatchRectCenter;
+    DetectorStatistics statistics;
+    ScanGrid grid;
+    /* Scan buffers kept between the frames */
+    std::vector<cv::Rect> testRects;
+    std::vector<int> windowOffsets;
+    std::vector<size_t> windowScales;
+    std::vector<double> confidences;
+    bool isRedetectionEnabled;
+    size_t redetectionBudget;
+    size_t redetectionCursor;
+    std::vector<RedetectionTile> redetectionTiles;
+    std::shared_ptr<NNClassifier> verifier;
+    std::vector<size_t> verifiedPatches;
+    std::vector<double> similarities;
 
-    Patch getPatch(const cv::Rect &testRect, const cv::Mat &frame, const cv::Rect &patchRect) const;
+    void redetect(const cv::Mat &integralFrame, const cv::Mat &squareIntegralFrame, const cv::Rect &patchRect,
+                  std::vector<Patch> &patches);
+    void buildRedetectionTiles();
+    void verify(const cv::Mat &frame, std::vector<Patch> &patches);
+    Patch getPatch(const cv::Rect &testRect, const double confidence, const cv::Rect &patchRect) const;
     bool checkPatchConformity(const Patch &patch) const;
     double getPatchVariance(const cv::Mat &integralFrame, const cv::Mat &squareIntegralFrame, const cv::Rect &patchRect) const;
     bool checkPatchVariace(const cv::Mat &integralFrame, const cv::Mat &squareIntegralFrame, const cv::Rect &patchRect) const;
-    cv::Rect getCurrentPatchRect(const cv::Rect &patchRect);
+    cv::Rect getCurrentPatchRect(const cv::Rect &patchRect, const double timestamp);
 };
 
 #endif /* DETECTOR_HPP */
@@ -1,11 +1,30 @@
 #include "Feature.hpp"
 #include <iostream>
+#include <mutex>
+#include <memory>
 
 
-Feature::Feature(const double minScale, const double maxScale)
+namespace
+{
+std::mutex seedMutex;
+std::unique_ptr<std::mt19937> seedEngine;
+
+unsigned int getFeatureSeed()
 {
+    std::lock_guard<std::mutex> lock(seedMutex);
+    if (seedEngine != nullptr)
+    {
+        return (*seedEngine)();
+    }
     std::random_device randomDevice;
-    std::mt19937 randomEngine(randomDevice());
+    return randomDevice();
+}
+}
+
+
+Feature::Feature(const double minScale, const double maxScale)
+{
+    std::mt19937 randomEngine(getFeatureSeed());
     std::uniform_real_distribution<double> distribution(0.0, 1.0);
     /* scaleW and scaleH in range minScale .. maxScale */
     scaleW = ((maxScale - minScale) * distribution(randomEngine)) + minScale;
@@ -17,7 +36,14 @@ Feature::Feature(const double minScale, const double maxScale)
 }
 
 
-int Feature::test(const cv::Mat &frame, const cv::Rect &patchRect)
+void Feature::setSeed(const unsigned int seed)
+{
+    std::lock_guard<std::mutex> lock(seedMutex);
+    seedEngine.reset(new std::mt19937(seed));
+}
+
+
+int Feature::test(const cv::Mat &frame, const cv::Rect &patchRect) const
 {
     int x = static_cast<int>(round(scaleX * patchRect.width)) + patchRect.x;
     int y = static_cast<int>(round(scaleY * patchRect.height)) + patchRect.y;
@@ -31,7 +57,51 @@ int Feature::test(const cv::Mat &frame, const cv::Rect &patchRect)
 }
 
 
-int Feature::sumRect(const cv::Mat &frame, const cv::Rect &patchRect)
+void Feature::getOffsets(const cv::Size &windowSize, const int step, int *offsets) const
+{
+    int x = static_cast<int>(round(scaleX * windowSize.width));
+    int y = static_cast<int>(round(scaleY * windowSize.height));
+    int w = static_cast<int>(round(scaleW * windowSize.width));
+    int h = static_cast<int>(round(scaleH * windowSize.height));
+    int columns[4] = {x, (x + (w / 2)), (x + (2 * (w / 2))), (x + w)};
+    int top = y * step;
+    int middle = (y + (h / 2)) * step;
+    int lower = (y + (2 * (h / 2))) * step;
+    int bottom = (y + h) * step;
+    offsets[0] = top + columns[0];
+    offsets[1] = top + columns[1];
+    offsets[2] = top + columns[2];
+    offsets[3] = top + columns[3];
+    offsets[4] = middle + columns[0];
+    offsets[5] = middle + columns[3];
+    offsets[6] = lower + columns[0];
+    offsets[7] = lower + columns[3];
+    offsets[8] = bottom + columns[0];
+    offsets[9] = bottom + columns[1];
+    offsets[10] = bottom + columns[2];
+    offsets[11] = bottom + columns[3];
+}
+
+
+void Feature::getScales(double *scales) const
+{
+    scales[0] = scaleX;
+    scales[1] = scaleY;
+    scales[2] = scaleW;
+    scales[3] = scaleH;
+}
+
+
+void Feature::setScales(const double *scales)
+{
+    scaleX = scales[0];
+    scaleY = scales[1];
+    scaleW = scales[2];
+    scaleH = scales[3];
+}
+
+
+int Feature::sumRect(const cv::Mat &frame, const cv::Rect &patchRect) const
 {
     return (frame.at<int>(cv::Point(patchRect.x + patchRect.width, patchRect.y + patchRect.height))
             + frame.at<int>(cv::Point(patchRect.x, patchRect.y))
@@ -8,15 +8,28 @@
 class Feature
 {
 public:
+    /* Integral frame corners of the left/right and top/bottom halves */
+    static const int cornersCount = 12;
+    /* Values describing the geometry, see getScales() */
+    static const int scalesCount = 4;
     Feature(const double minScale, const double maxScale);
-    int test(const cv::Mat &frame, const cv::Rect &patchRect);
+    /* Makes the geometry of the features created afterwards reproducible,
+     * by default every feature is seeded from std::random_device */
+    static void setSeed(const unsigned int seed);
+    int test(const cv::Mat &frame, const cv::Rect &patchRect) const;
+    /* Offsets of the corners from the window top-left corner in an integral
+     * frame with rows of step elements, the same geometry test() uses */
+    void getOffsets(const cv::Size &windowSize, const int step, int *offsets) const;
+    /* The geometry relative to the window: x, y, width and height */
+    void getScales(double *scales) const;
+    void setScales(const double *scales);
 
 private:
     double scaleX;
     double scaleY;
     double scaleW;
     double scaleH;
-    int sumRect(const cv::Mat &frame, const cv::Rect &patchRect);
+    int sumRect(const cv::Mat &frame, const cv::Rect &patchRect) const;
 };
 
 #endif /* FEATURE_HPP */
@@ -1,54 +1,28 @@
 #include "Fern.hpp"
 
 
-Fern::Fern(const int featuresCount, const double minScale, const double maxScale)
-{
-    for (int feature = 0; feature < featuresCount; ++feature)
-    {
-        features.push_back(std::make_shared<Feature>(minScale, maxScale));
-    }
-    leafsCount = pow(4, featuresCount);
-    leafs = std::vector<Leaf>(leafsCount);
-}
+Fern::Fern(const Feature *features, const int featuresCount, const uint16_t *posteriors)
+: features(features), featuresCount(featuresCount), posteriors(posteriors) {}
 
 
-void Fern::train(const cv::Mat &frame, const cv::Rect &patchRect, const bool isPositive)
+double Fern::classify(const cv::Mat &frame, const cv::Rect &patchRect) const
 {
-    int leaf = getLeafIndex(frame, patchRect);
-    if (isPositive == true)
-    {
-        leafs[leaf].increment();
-    }
-    else
-    {
-        leafs[leaf].decrement();
-    }
+    return (static_cast<double>(getPosterior(frame, patchRect)) / posteriorScale);
 }
 
 
-double Fern::classify(const cv::Mat &frame, const cv::Rect &patchRect) const
+int Fern::getPosterior(const cv::Mat &frame, const cv::Rect &patchRect) const
 {
-    return leafs.at(getLeafIndex(frame, patchRect)).load();
+    return posteriors[getLeafIndex(frame, patchRect)];
 }
 
 
 int Fern::getLeafIndex(const cv::Mat &frame, const cv::Rect &patchRect) const
 {
     int leaf = 0;
-    int featureCounter = 0;
-    for (auto feature: features)
+    for (int feature = 0; feature < featuresCount; ++feature)
     {
-        leaf += (feature->test(frame, patchRect) << (2 * featureCounter));
-        featureCounter++;
+        leaf += (features[feature].test(frame, patchRect) << (2 * feature));
     }
     return leaf;
 }
-
-
-void Fern::reset()
-{
-    for (int leaf = 0; leaf < leafsCount; ++leaf)
-    {
-        leafs[leaf].reset();
-    }
-}
@@ -2,27 +2,29 @@
 #define FERN_HPP
 
 #include <vector>
+#include <cstdint>
 #include <iostream>
 
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "Feature.hpp"
-#include "Leaf.hpp"
 
+/* View of one fern inside the flat Classifier tables: featuresCount
+ * features and 4^featuresCount posteriors quantized to 0..posteriorScale */
 class Fern
 {
 public:
-    explicit Fern(const int featuresCount, const double minScale, const double maxScale);
+    static const int posteriorScale = 0xFFFF;
+    explicit Fern(const Feature *features, const int featuresCount, const uint16_t *posteriors);
     ~Fern() = default;
-    void train(const cv::Mat &frame, const cv::Rect &patchRect, const bool isPositive);
+    int getLeafIndex(const cv::Mat &frame, const cv::Rect &patchRect) const;
+    int getPosterior(const cv::Mat &frame, const cv::Rect &patchRect) const;
     double classify(const cv::Mat &frame, const cv::Rect &patchRect) const;
-    void reset();
 
 private:
-    int leafsCount;
-    std::vector<std::shared_ptr<Feature>> features;
-    std::vector<Leaf> leafs;
-    int getLeafIndex(const cv::Mat &frame, const cv::Rect &patchRect) const;
+    const Feature *features;
+    int featuresCount;
+    const uint16_t *posteriors;
 };
 
 #endif /* FERN_HPP */
@@ -0,0 +1,155 @@
+#include "FrameContext.hpp"
+
+
+FrameContext::FrameContext(const cv::Mat &frame, const FrameFormat format)
+    : source(frame), format(format), region(0, 0, frame.cols, frame.rows),
+      timestamp(getClockTime())
+{
+    /* The luma formats skip the conversion, any other type would be taken as the gray frame */
+    CV_Assert((format == FrameFormat::Rgb) || (frame.type() == CV_8UC1));
+}
+
+
+FrameContext::FrameContext(const uint8_t *luma, const int width, const int height, const size_t stride,
+                           const FrameFormat format)
+    : source(height, width, CV_8UC1, const_cast<uint8_t *>(luma), stride), format(format), region(0, 0, width, height),
+      timestamp(getClockTime()) {}
+
+
+void FrameContext::setRegion(const cv::Rect &region)
+{
+    this->region = region & cv::Rect(0, 0, source.cols, source.rows);
+}
+
+
+const cv::Rect &FrameContext::getRegion() const
+{
+    return region;
+}
+
+
+bool FrameContext::isWholeFrame() const
+{
+    return (region.size() == source.size());
+}
+
+
+void FrameContext::setTimestamp(const double timestamp)
+{
+    this->timestamp = timestamp;
+}
+
+
+double FrameContext::getTimestamp() const
+{
+    return timestamp;
+}
+
+
+double FrameContext::getClockTime()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+
+const cv::Mat &FrameContext::getGray() const
+{
+    std::call_once(grayFlag, [this]
+    {
+        if ((format != FrameFormat::Rgb) || (source.channels() == 1))
+        {
+            gray = source;
+        }
+        else
+        {
+            /* One more pixel around the region for the blur */
+            cv::Rect grayRegion(region.x - 1, region.y - 1, region.width + 2, region.height + 2);
+            grayRegion &= cv::Rect(0, 0, source.cols, source.rows);
+            gray.create(source.size(), CV_8UC1);
+            cv::Mat grayView = gray(grayRegion);
+            cv::cvtColor(source(grayRegion), grayView, cv::COLOR_RGB2GRAY);
+        }
+    });
+    return gray;
+}
+
+
+const cv::Mat &FrameContext::getFrame() const
+{
+    std::call_once(frameFlag, [this]
+    {
+        if (format == FrameFormat::BlurredLuma)
+        {
+            frame = source;
+        }
+        else
+        {
+            /* The blur of a view reads the pixels around it like on the whole frame */
+            frame.create(source.size(), CV_8UC1);
+            cv::Mat frameView = frame(region);
+            cv::blur(getGray()(region), frameView, cv::Size(3, 3));
+        }
+    });
+    return frame;
+}
+
+
+const cv::Mat &FrameContext::getIntegral() const
+{
+    std::call_once(integralFlag, [this]
+    {
+        integralFrame.create((source.rows + 1), (source.cols + 1), CV_32S);
+        cv::Mat integralView = integralFrame(getIntegralRegion());
+        cv::integral(getFrame()(region), integralView, CV_32S);
+    });
+    return integralFrame;
+}
+
+
+const cv::Mat &FrameContext::getSquareIntegral() const
+{
+    std::call_once(squareIntegralFlag, [this]
+    {
+        /* Both sums come from one pass, keep the plain one if nobody asked for it yet */
+        cv::Mat sumFrame((source.rows + 1), (source.cols + 1), CV_32S);
+        squareIntegralFrame.create((source.rows + 1), (source.cols + 1), CV_64F);
+        cv::Mat sumView = sumFrame(getIntegralRegion());
+        cv::Mat squareView = squareIntegralFrame(getIntegralRegion());
+        cv::integral(getFrame()(region), sumView, squareView, CV_32S, CV_64F);
+        std::call_once(integralFlag, [this, &sumFrame]
+        {
+            integralFrame = sumFrame;
+        });
+    });
+    return squareIntegralFrame;
+}
+
+
+const std::vector<cv::Mat> &FrameContext::getPyramid(const cv::Size &windowSize, const int pyramidLevel) const
+{
+    std::call_once(pyramidFlag, [this, &windowSize, pyramidLevel]
+    {
+        /* Isolated, the frame around a region is uninitialized */
+        cv::buildOpticalFlowPyramid(getFrame()(region), pyramid, windowSize, pyramidLevel, true,
+                                    (cv::BORDER_REFLECT_101 | cv::BORDER_ISOLATED));
+    });
+    return pyramid;
+}
+
+
+int FrameContext::getWidth() const
+{
+    return source.cols;
+}
+
+
+int FrameContext::getHeight() const
+{
+    return source.rows;
+}
+
+
+cv::Rect FrameContext::getIntegralRegion() const
+{
+    return cv::Rect(region.x, region.y, (region.width + 1), (region.height + 1));
+}
@@ -0,0 +1,88 @@
+#ifndef FRAMECONTEXT_HPP
+#define FRAMECONTEXT_HPP
+
+#include <vector>
+#include <mutex>
+#include <cstdint>
+#include <chrono>
+
+#include <opencv2/imgproc/imgproc.hpp>
+#include <opencv2/video/tracking.hpp>
+
+
+/* Layout of the input frame. Rgb also accepts single channel frames.
+ * Luma is an 8-bit grayscale plane, e.g. the Y plane of NV12 or I420,
+ * used without the color conversion. BlurredLuma is a grayscale plane
+ * already blurred like getFrame(), used as it is. */
+enum class FrameFormat
+{
+    Rgb,
+    Luma,
+    BlurredLuma
+};
+
+
+/* Images derived from one input frame. Every product is computed on
+ * first use and then shared by the tracker, the detector and the
+ * classifier, the getters may be called concurrently. The input is
+ * never copied nor written; a BlurredLuma frame is used in place by
+ * the tracker until the next frame, so it has to stay unchanged until then.
+ * With a region set the products keep the frame geometry (the integral
+ * frames one more row and column) but only the region is computed, the
+ * rest is left uninitialized. The integral frames are accumulated from
+ * the region corner, so the sums of the rects inside the region match
+ * the whole frame ones at the same offsets. */
+class FrameContext
+{
+public:
+    /* Luma and BlurredLuma frames have to be CV_8UC1, cv::Exception otherwise */
+    explicit FrameContext(const cv::Mat &frame, const FrameFormat format = FrameFormat::Rgb);
+    /* Non-owning view of a luma plane with rows of stride bytes */
+    FrameContext(const uint8_t *luma, const int width, const int height, const size_t stride,
+                 const FrameFormat format = FrameFormat::Luma);
+    ~FrameContext() = default;
+    FrameContext(const FrameContext &other) = delete;
+    FrameContext &operator=(const FrameContext &other) = delete;
+    /* Restricts the products to the region (clipped to the frame),
+     * has to be called before any of them is requested */
+    void setRegion(const cv::Rect &region);
+    /* The whole frame unless restricted */
+    const cv::Rect &getRegion() const;
+    bool isWholeFrame() const;
+    /* Time of the frame in seconds, e.g. its position in a video, which drives
+     * the motion prediction. Defaults to getClockTime() at the construction. */
+    void setTimestamp(const double timestamp);
+    double getTimestamp() const;
+    /* Seconds of the steady clock */
+    static double getClockTime();
+    const cv::Mat &getGray() const;
+    /* Blurred grayscale frame all the stages work on */
+    const cv::Mat &getFrame() const;
+    const cv::Mat &getIntegral() const;
+    const cv::Mat &getSquareIntegral() const;
+    /* Pyramid of the region, in the region coordinates. The parameters
+     * of the first call are used for the frame lifetime. */
+    const std::vector<cv::Mat> &getPyramid(const cv::Size &windowSize, const int pyramidLevel) const;
+    int getWidth() const;
+    int getHeight() const;
+
+private:
+    cv::Mat source;
+    FrameFormat format;
+    cv::Rect region;
+    double timestamp;
+    mutable cv::Mat gray;
+    mutable cv::Mat frame;
+    mutable cv::Mat integralFrame;
+    mutable cv::Mat squareIntegralFrame;
+    mutable std::vector<cv::Mat> pyramid;
+    mutable std::once_flag grayFlag;
+    mutable std::once_flag frameFlag;
+    mutable std::once_flag integralFlag;
+    mutable std::once_flag squareIntegralFlag;
+    mutable std::once_flag pyramidFlag;
+
+    cv::Rect getIntegralRegion() const;
+};
+
+#endif /* FRAMECONTEXT_HPP */
@@ -1,97 +1,212 @@
 #include "KalmanFilter.hpp"
 
+#include <cmath>
+#include <limits>
+#include <algorithm>
 
-KalmanFilter::KalmanFilter()
+
+namespace
+{
+const int stateSize = KalmanFilter::stateSize;
+const int measurementSize = KalmanFilter::measurementSize;
+const int covarianceSize = stateSize * stateSize;
+const int lostFramesLimit = KalmanFilter::maxLostFrames;
+const float processNoise[stateSize] = {1e-2f, 1e-2f, 5.0f, 5.0f, 1e-2f, 1e-2f};
+const float measurementNoise = 1e-1f;
+/* State values of the measurement: center x, y, width, height */
+const int measuredValues[measurementSize] = {0, 1, 4, 5};
+const double noTimestamp = std::numeric_limits<double>::quiet_NaN();
+
+
+/* x = F x and P = F P F^T + Q, F adds dT times the velocities to the positions */
+void predictState(float *x, float *p, const float timeStep)
 {
-    init();
+    for (int i = 0; i < 2; ++i)
+    {
+        x[i] += timeStep * x[i + 2];
+    }
+    /* The position rows first and then the position columns */
+    for (int i = 0; i < 2; ++i)
+    {
+        for (int c = 0; c < stateSize; ++c)
+        {
+            p[(i * stateSize) + c] += timeStep * p[((i + 2) * stateSize) + c];
+        }
+        for (int r = 0; r < stateSize; ++r)
+        {
+            p[(r * stateSize) + i] += timeStep * p[(r * stateSize) + i + 2];
+        }
+    }
+    for (int i = 0; i < stateSize; ++i)
+    {
+        p[i * (stateSize + 1)] += processNoise[i];
+    }
 }
 
 
-cv::Rect KalmanFilter::predict(const cv::Rect &rect)
+void correct(float *x, float *p, const float *measurements)
 {
-    cv::Rect result(0, 0, 0, 0);
+    /* K = P H^T S^-1 with S = H P H^T + R. S X = H P is solved for X = K^T
+     * by Gauss-Jordan elimination, S is positive definite. */
+    float innovation[measurementSize * measurementSize];
+    float rows[measurementSize * stateSize];
+    float gains[measurementSize * stateSize];
+    float residuals[measurementSize];
+    for (int j = 0; j < measurementSize; ++j)
+    {
+        for (int k = 0; k < measurementSize; ++k)
+        {
+            float noise = ((j == k) ? measurementNoise : 0.0f);
+            innovation[(j * measurementSize) + k] = p[(measuredValues[j] * stateSize) + measuredValues[k]] + noise;
+        }
+        for (int c = 0; c < stateSize; ++c)
+        {
+            rows[(j * stateSize) + c] = p[(measuredValues[j] * stateSize) + c];
+            gains[(j * stateSize) + c] = p[(measuredValues[j] * stateSize) + c];
+        }
+        residuals[j] = measurements[j] - x[measuredValues[j]];
+    }
+    for (int pivot = 0; pivot < measurementSize; ++pivot)
+    {
+        float factor = 1.0f / innovation[(pivot * measurementSize) + pivot];
+        for (int k = 0; k < measurementSize; ++k)
+        {
+            innovation[(pivot * measurementSize) + k] *= factor;
+        }
+        for (int c = 0; c < stateSize; ++c)
+        {
+            gains[(pivot * stateSize) + c] *= factor;
+        }
+        for (int j = 0; j < measurementSize; ++j)
+        {
+            if (j == pivot)
+            {
+                continue;
+            }
+            factor = innovation[(j * measurementSize) + pivot];
+            for (int k = 0; k < measurementSize; ++k)
+            {
+                innovation[(j * measurementSize) + k] -= factor * innovation[(pivot * measurementSize) + k];
+            }
+            for (int c = 0; c < stateSize; ++c)
+            {
+                gains[(j * stateSize) + c] -= factor * gains[(pivot * stateSize) + c];
+            }
+        }
+    }
+    for (int i = 0; i < stateSize; ++i)
+    {
+        for (int j = 0; j < measurementSize; ++j)
+        {
+            x[i] += gains[(j * stateSize) + i] * residuals[j];
+        }
+    }
+    for (int r = 0; r < stateSize; ++r)
+    {
+        for (int c = 0; c < stateSize; ++c)
+        {
+            for (int j = 0; j < measurementSize; ++j)
+            {
+                p[(r * stateSize) + c] -= gains[(j * stateSize) + r] * rows[(j * stateSize) + c];
+            }
+        }
+    }
+}
+}
+
 
-    previousTicks = currentTicks;
-    currentTicks = cv::getTickCount();
-    float dT = static_cast<float>(currentTicks - previousTicks) / cv::getTickFrequency();
+KalmanFilter::KalmanFilter()
+{
+    reset();
+}
 
-    if (lostCounter < 50) {
-        filter.transitionMatrix.at<float>(2) = dT;
-        filter.transitionMatrix.at<float>(9) = dT;
-        state = filter.predict();
 
-        result.width = state.at<float>(4);
-        result.height = state.at<float>(5);
-        result.x = state.at<float>(0) - (result.width / 2);
-        result.y = state.at<float>(1) - (result.height / 2);
+cv::Rect KalmanFilter::predict(const cv::Rect &rect, const double timestamp)
+{
+    cv::Rect result(0, 0, 0, 0);
+    bool isPredicting = ((isInitialized != 0) && (lostCounter < lostFramesLimit));
+    if (isPredicting == true)
+    {
+        double timeStep = ((std::isnan(lastTimestamp) == true) ? 0.0 : std::max(0.0, (timestamp - lastTimestamp)));
+        predictState(state, covariance, static_cast<float>(timeStep));
+        result.width = static_cast<int>(state[4]);
+        result.height = static_cast<int>(state[5]);
+        result.x = static_cast<int>(state[0] - (result.width / 2));
+        result.y = static_cast<int>(state[1] - (result.height / 2));
     }
 
-    if (rect.area() > 0) {
-        measurment.at<float>(0) = rect.x + (rect.width / 2);
-        measurment.at<float>(1) = rect.y + (rect.height / 2);
-        measurment.at<float>(2) = static_cast<float>(rect.width);
-        measurment.at<float>(3) = static_cast<float>(rect.height);
-
-        if (isInitialized == false) {
-            filter.errorCovPre.at<float>(0) = 1;
-            filter.errorCovPre.at<float>(7) = 1;
-            filter.errorCovPre.at<float>(14) = 1;
-            filter.errorCovPre.at<float>(21) = 1;
-            filter.errorCovPre.at<float>(28) = 1;
-            filter.errorCovPre.at<float>(35) = 1;
-
-            state.at<float>(0) = measurment.at<float>(0);
-            state.at<float>(1) = measurment.at<float>(1);
-            state.at<float>(2) = 0;
-            state.at<float>(3) = 0;
-            state.at<float>(4) = measurment.at<float>(2);
-            state.at<float>(5) = measurment.at<float>(3);
-
-            isInitialized = true;
-        } else {
-            filter.correct(measurment);
+    if (rect.area() > 0)
+    {
+        const float measurements[measurementSize] = {static_cast<float>(rect.x + (rect.width / 2)),
+                                                     static_cast<float>(rect.y + (rect.height / 2)),
+                                                     static_cast<float>(rect.width),
+                                                     static_cast<float>(rect.height)};
+        if (isPredicting == true)
+        {
+            correct(state, covariance, measurements);
+        }
+        else
+        {
+            /* A new or lost target starts at the measurement without velocity */
+            std::fill(state, (state + stateSize), 0.0f);
+            for (int j = 0; j < measurementSize; ++j)
+            {
+                state[measuredValues[j]] = measurements[j];
+            }
+            for (int i = 0; i < covarianceSize; ++i)
+            {
+                covariance[i] = (((i % (stateSize + 1)) == 0) ? 1.0f : 0.0f);
+            }
+            isInitialized = 1;
         }
-
         lostCounter = 0;
-    } else {
-        lostCounter++;
     }
-
+    else
+    {
+        lostCounter = std::min((lostCounter + 1), lostFramesLimit);
+    }
+    lastTimestamp = timestamp;
     return result;
 }
 
 
 void KalmanFilter::reset()
 {
-    init();
+    std::fill(state, (state + stateSize), 0.0f);
+    std::fill(covariance, (covariance + covarianceSize), 0.0f);
+    lastTimestamp = noTimestamp;
+    lostCounter = 0;
+    isInitialized = 0;
 }
 
 
-void KalmanFilter::init()
+void KalmanFilter::save(snapshot::Writer &writer) const
 {
-    filter = cv::KalmanFilter(6, 4, 0, CV_32F);
-
-    state = cv::Mat(6, 1, CV_32F);
-    measurment = cv::Mat(4, 1, CV_32F);
-
-    cv::setIdentity(filter.transitionMatrix);
-
-    filter.measurementMatrix = cv::Mat::zeros(4, 6, CV_32F);
-    filter.measurementMatrix.at<float>(0) = 1.0f;
-    filter.measurementMatrix.at<float>(7) = 1.0f;
-    filter.measurementMatrix.at<float>(16) = 1.0f;
-    filter.measurementMatrix.at<float>(23) = 1.0f;
-
-    filter.processNoiseCov.at<float>(0) = 1e-2;
-    filter.processNoiseCov.at<float>(7) = 1e-2;
-    filter.processNoiseCov.at<float>(14) = 5.0f;
-    filter.processNoiseCov.at<float>(21) = 5.0f;
-    filter.processNoiseCov.at<float>(28) = 1e-2;
-    filter.processNoiseCov.at<float>(35) = 1e-2;
+    writer.write(lostCounter);
+    writer.write(isInitialized);
+    writer.writeArray(state, stateSize);
+    writer.writeArray(covariance, covarianceSize);
+}
 
-    cv::setIdentity(filter.measurementNoiseCov, cv::Scalar(1e-1));
 
-    currentTicks = 0;
-    lostCounter = 0;
-    isInitialized = false;
+bool KalmanFilter::load(snapshot::Reader &reader)
+{
+    int savedLostCounter = 0;
+    uint8_t savedIsInitialized = 0;
+    float savedState[stateSize];
+    float savedCovariance[covarianceSize];
+    reader.read(savedLostCounter);
+    reader.read(savedIsInitialized);
+    reader.readArray(savedState, stateSize);
+    reader.readArray(savedCovariance, covarianceSize);
+    if (reader.isValid() == false)
+    {
+        return false;
+    }
+    std::copy(savedState, (savedState + stateSize), state);
+    std::copy(savedCovariance, (savedCovariance + covarianceSize), covariance);
+    lostCounter = std::min(std::max(savedLostCounter, 0), lostFramesLimit);
+    isInitialized = ((savedIsInitialized != 0) ? 1 : 0);
+    lastTimestamp = noTimestamp;
+    return true;
 }
@@ -4,24 +4,41 @@
 #include <opencv2/opencv.hpp>
 
 #include <iostream>
+#include <cstdint>
 
+#include "Snapshot.hpp"
 
+
+/* Constant velocity model of a rect: the state is the center x, y, its
+ * velocity and the width, height, the measurement the center and the size.
+ * The time step is the difference of the frame timestamps (seconds), so the
+ * prediction does not depend on the processing speed. Fixed-size, nothing
+ * is allocated after the construction. */
 class KalmanFilter
 {
 public:
+    static const int stateSize = 6;
+    static const int measurementSize = 4;
+    /* Misses after which the filter stops predicting, the next
+     * measurement starts it anew */
+    static const int maxLostFrames = 50;
     KalmanFilter();
-    cv::Rect predict(const cv::Rect &rect);
+    /* Predicts the rect at timestamp from the previous frames and then
+     * corrects the state with rect, an empty rect is a miss. The prediction
+     * is empty before the first measurement and after maxLostFrames misses. */
+    cv::Rect predict(const cv::Rect &rect, const double timestamp);
     void reset();
+    /* load() changes nothing and returns false for a truncated snapshot,
+     * the time step restarts at the load */
+    void save(snapshot::Writer &writer) const;
+    bool load(snapshot::Reader &reader);
 
 private:
-    cv::KalmanFilter filter;
-    cv::Mat state;
-    cv::Mat measurment;
-    int64_t previousTicks;
-    int64_t currentTicks;
+    float state[stateSize];
+    float covariance[stateSize * stateSize];
+    double lastTimestamp;
     int lostCounter;
-    bool isInitialized;
-    void init();
+    uint8_t isInitialized;
 };
 
 
@@ -0,0 +1,550 @@
+#include "Kernels.hpp"
+
+#include <atomic>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KERNELS_X86
+#include <immintrin.h>
+#endif
+
+
+namespace
+{
+const int cornersCount = 12;
+
+std::atomic<bool> isSimdAllowed(true);
+
+bool hasAvx2()
+{
+#ifdef KERNELS_X86
+    static const bool result = (__builtin_cpu_supports("avx2") != 0);
+    return result;
+#else
+    return false;
+#endif
+}
+
+
+bool isAvx2Enabled()
+{
+    return (isSimdAllowed.load() && hasAvx2());
+}
+
+
+/* Same comparisons as Feature::test() on the corners of Feature::getOffsets() */
+inline int getFeatureCode(const int *window, const int *offsets)
+{
+    int left = window[offsets[9]] + window[offsets[0]] - window[offsets[1]] - window[offsets[8]];
+    int right = window[offsets[10]] + window[offsets[1]] - window[offsets[2]] - window[offsets[9]];
+    int top = window[offsets[5]] + window[offsets[0]] - window[offsets[3]] - window[offsets[4]];
+    int bottom = window[offsets[7]] + window[offsets[4]] - window[offsets[5]] - window[offsets[6]];
+    return ((left > right) ? 0 : 2) + ((top > bottom) ? 0 : 1);
+}
+
+
+/* The ensemble kernels take the counts as template arguments as well,
+ * 0 stands for a count known only at runtime. With the constants the
+ * compiler unrolls the loops over the features and the corners. */
+template<int FEATURES>
+inline int getLeafIndex(const int *window, const int *offsets, const int featuresCount)
+{
+    const int count = ((FEATURES > 0) ? FEATURES : featuresCount);
+    int leaf = 0;
+    for (int feature = 0; feature < count; ++feature)
+    {
+        leaf |= (getFeatureCode(window, offsets) << (2 * feature));
+        offsets += cornersCount;
+    }
+    return leaf;
+}
+
+
+template<int FERNS, int FEATURES>
+void getPosteriorSumsScalar(const int *integralFrame, const int *windowOffsets, const size_t windowsCount,
+                            const int *featureOffsets, const int fernsCount, const int featuresCount,
+                            const uint16_t *posteriors, int *sums)
+{
+    const int ferns = ((FERNS > 0) ? FERNS : fernsCount);
+    const int features = ((FEATURES > 0) ? FEATURES : featuresCount);
+    const int leafsCount = 1 << (2 * features);
+    for (size_t window = 0; window < windowsCount; ++window)
+    {
+        const int *base = integralFrame + windowOffsets[window];
+        int sum = 0;
+        for (int fern = 0; fern < ferns; ++fern)
+        {
+            int leaf = getLeafIndex<FEATURES>(base, (featureOffsets + (fern * features * cornersCount)), features);
+            sum += posteriors[(fern * leafsCount) + leaf];
+        }
+        sums[window] = sum;
+    }
+}
+
+
+template<int FERNS, int FEATURES>
+void getLeafIndicesScalar(const int *integralFrame, const int *windowOffsets, const size_t windowsCount,
+                          const int *featureOffsets, const int fernsCount, const int featuresCount,
+                          int *leafIndices, const size_t stride)
+{
+    const int ferns = ((FERNS > 0) ? FERNS : fernsCount);
+    const int features = ((FEATURES > 0) ? FEATURES : featuresCount);
+    for (size_t window = 0; window < windowsCount; ++window)
+    {
+        const int *base = integralFrame + windowOffsets[window];
+        for (int fern = 0; fern < ferns; ++fern)
+        {
+            leafIndices[(fern * stride) + window] =
+                getLeafIndex<FEATURES>(base, (featureOffsets + (fern * features * cornersCount)), features);
+        }
+    }
+}
+
+
+void getDotProductsScalar(const float *vector, const float *vectors, const size_t count, const size_t length,
+                          float *products)
+{
+    for (size_t index = 0; index < count; ++index)
+    {
+        const float *other = vectors + (index * length);
+        float product = 0.0f;
+        for (size_t element = 0; element < length; ++element)
+        {
+            product += vector[element] * other[element];
+        }
+        products[index] = product;
+    }
+}
+
+
+/* Top-left sample and bilinear weights of a patch, as in cv::getRectSubPix() */
+struct SubPixelPatch
+{
+    int x;
+    int y;
+    float weights[4];
+    bool isInside;
+};
+
+
+inline SubPixelPatch getSubPixelPatch(const float *center, const int patchSize, const int width, const int height)
+{
+    SubPixelPatch patch;
+    float x = center[0] - ((patchSize - 1) * 0.5f);
+    float y = center[1] - ((patchSize - 1) * 0.5f);
+    patch.x = static_cast<int>(std::floor(x));
+    patch.y = static_cast<int>(std::floor(y));
+    float a = x - patch.x;
+    float b = y - patch.y;
+    patch.weights[0] = (1.0f - a) * (1.0f - b);
+    patch.weights[1] = a * (1.0f - b);
+    patch.weights[2] = (1.0f - a) * b;
+    patch.weights[3] = a * b;
+    patch.isInside = ((patch.x >= 0) && (patch.y >= 0)
+                      && ((patch.x + patchSize) < width) && ((patch.y + patchSize) < height));
+    return patch;
+}
+
+
+inline float getSample(const uint8_t *frame, const size_t step, const int width, const int height,
+                       const SubPixelPatch &patch, const int column, const int row)
+{
+    int x0 = patch.x + column;
+    int y0 = patch.y + row;
+    int x1 = x0 + 1;
+    int y1 = y0 + 1;
+    if (patch.isInside == false)
+    {
+        x0 = std::min(std::max(x0, 0), (width - 1));
+        x1 = std::min(std::max(x1, 0), (width - 1));
+        y0 = std::min(std::max(y0, 0), (height - 1));
+        y1 = std::min(std::max(y1, 0), (height - 1));
+    }
+    const uint8_t *row0 = frame + (y0 * step);
+    const uint8_t *row1 = frame + (y1 * step);
+    return (patch.weights[0] * row0[x0]) + (patch.weights[1] * row0[x1])
+        + (patch.weights[2] * row1[x0]) + (patch.weights[3] * row1[x1]);
+}
+
+
+double getCrossCorrelationScalar(const uint8_t *prevFrame, const uint8_t *nextFrame, const size_t prevStep,
+                                 const size_t nextStep, const int width, const int height, const SubPixelPatch &prevPatch,
+                                 const SubPixelPatch &nextPatch, const int patchSize)
+{
+    double sumPrev = 0.0;
+    double sumNext = 0.0;
+    double sumProduct = 0.0;
+    for (int row = 0; row < patchSize; ++row)
+    {
+        for (int column = 0; column < patchSize; ++column)
+        {
+            float prevValue = getSample(prevFrame, prevStep, width, height, prevPatch, column, row);
+            float nextValue = getSample(nextFrame, nextStep, width, height, nextPatch, column, row);
+            sumPrev += prevValue;
+            sumNext += nextValue;
+            sumProduct += prevValue * nextValue;
+        }
+    }
+    return sumProduct - ((sumPrev * sumNext) / (patchSize * patchSize));
+}
+
+
+void getCrossCorrelationsScalar(const uint8_t *prevFrame, const uint8_t *nextFrame, const size_t prevStep,
+                                const size_t nextStep, const int width, const int height, const float *prevPoints, const float *nextPoints,
+                                const size_t pointsCount, const int patchSize, double *correlations)
+{
+    for (size_t point = 0; point < pointsCount; ++point)
+    {
+        SubPixelPatch prevPatch = getSubPixelPatch((prevPoints + (2 * point)), patchSize, width, height);
+        SubPixelPatch nextPatch = getSubPixelPatch((nextPoints + (2 * point)), patchSize, width, height);
+        correlations[point] = getCrossCorrelationScalar(prevFrame, nextFrame, prevStep, nextStep, width, height,
+                                                        prevPatch, nextPatch, patchSize);
+    }
+}
+
+
+#ifdef KERNELS_X86
+/* Leaf indices of one fern for eight windows, the corners are gathered from the integral frame */
+template<int FEATURES>
+__attribute__((target("avx2")))
+inline __m256i getLeafIndicesAvx2(const int *integralFrame, const __m256i bases, const int *offsets,
+                                  const int featuresCount)
+{
+    const int count = ((FEATURES > 0) ? FEATURES : featuresCount);
+    const __m256i two = _mm256_set1_epi32(2);
+    const __m256i one = _mm256_set1_epi32(1);
+    __m256i leaf = _mm256_setzero_si256();
+    for (int feature = 0; feature < count; ++feature)
+    {
+        __m256i corners[cornersCount];
+        for (int corner = 0; corner < cornersCount; ++corner)
+        {
+            __m256i indices = _mm256_add_epi32(bases, _mm256_set1_epi32(offsets[corner]));
+            corners[corner] = _mm256_i32gather_epi32(integralFrame, indices, 4);
+        }
+        __m256i left = _mm256_sub_epi32(_mm256_add_epi32(corners[9], corners[0]),
+                                        _mm256_add_epi32(corners[1], corners[8]));
+        __m256i right = _mm256_sub_epi32(_mm256_add_epi32(corners[10], corners[1]),
+                                         _mm256_add_epi32(corners[2], corners[9]));
+        __m256i top = _mm256_sub_epi32(_mm256_add_epi32(corners[5], corners[0]),
+                                       _mm256_add_epi32(corners[3], corners[4]));
+        __m256i bottom = _mm256_sub_epi32(_mm256_add_epi32(corners[7], corners[4]),
+                                          _mm256_add_epi32(corners[5], corners[6]));
+        __m256i code = _mm256_or_si256(_mm256_andnot_si256(_mm256_cmpgt_epi32(left, right), two),
+                                       _mm256_andnot_si256(_mm256_cmpgt_epi32(top, bottom), one));
+        leaf = _mm256_or_si256(leaf, _mm256_slli_epi32(code, (2 * feature)));
+        offsets += cornersCount;
+    }
+    return leaf;
+}
+
+
+/* Eight windows per iteration */
+template<int FERNS, int FEATURES>
+__attribute__((target("avx2")))
+void getPosteriorSumsAvx2(const int *integralFrame, const int *windowOffsets, const size_t windowsCount,
+                          const int *featureOffsets, const int fernsCount, const int featuresCount,
+                          const uint16_t *posteriors, int *sums)
+{
+    const int ferns = ((FERNS > 0) ? FERNS : fernsCount);
+    const int features = ((FEATURES > 0) ? FEATURES : featuresCount);
+    const int leafsCount = 1 << (2 * features);
+    const __m256i posteriorMask = _mm256_set1_epi32(0xFFFF);
+    size_t window = 0;
+    for (; (window + 8) <= windowsCount; window += 8)
+    {
+        const __m256i bases = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(windowOffsets + window));
+        __m256i sum = _mm256_setzero_si256();
+        for (int fern = 0; fern < ferns; ++fern)
+        {
+            __m256i leaf = getLeafIndicesAvx2<FEATURES>(integralFrame, bases, (featureOffsets + (fern * features * cornersCount)),
+                                                        features);
+            __m256i indices = _mm256_add_epi32(leaf, _mm256_set1_epi32(fern * leafsCount));
+            __m256i values = _mm256_i32gather_epi32(reinterpret_cast<const int *>(posteriors), indices, 2);
+            sum = _mm256_add_epi32(sum, _mm256_and_si256(values, posteriorMask));
+        }
+        _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums + window), sum);
+    }
+    if (window < windowsCount)
+    {
+        getPosteriorSumsScalar<FERNS, FEATURES>(integralFrame, (windowOffsets + window), (windowsCount - window),
+                                                featureOffsets, fernsCount, featuresCount, posteriors, (sums + window));
+    }
+}
+
+
+template<int FERNS, int FEATURES>
+__attribute__((target("avx2")))
+void getLeafIndicesAvx2(const int *integralFrame, const int *windowOffsets, const size_t windowsCount,
+                        const int *featureOffsets, const int fernsCount, const int featuresCount,
+                        int *leafIndices, const size_t stride)
+{
+    const int ferns = ((FERNS > 0) ? FERNS : fernsCount);
+    const int features = ((FEATURES > 0) ? FEATURES : featuresCount);
+    size_t window = 0;
+    for (; (window + 8) <= windowsCount; window += 8)
+    {
+        const __m256i bases = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(windowOffsets + window));
+        for (int fern = 0; fern < ferns; ++fern)
+        {
+            __m256i leaf = getLeafIndicesAvx2<FEATURES>(integralFrame, bases, (featureOffsets + (fern * features * cornersCount)),
+                                                        features);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(leafIndices + (fern * stride) + window), leaf);
+        }
+    }
+    if (window < windowsCount)
+    {
+        getLeafIndicesScalar<FERNS, FEATURES>(integralFrame, (windowOffsets + window), (windowsCount - window),
+                                              featureOffsets, fernsCount, featuresCount, (leafIndices + window), stride);
+    }
+}
+
+
+__attribute__((target("avx2")))
+inline __m256 loadPixels(const uint8_t *pixels)
+{
+    return _mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(pixels))));
+}
+
+
+__attribute__((target("avx2")))
+inline double getSum(const __m256 values)
+{
+    __m128 sum = _mm_add_ps(_mm256_castps256_ps128(values), _mm256_extractf128_ps(values, 1));
+    sum = _mm_add_ps(sum, _mm_movehl_ps(sum, sum));
+    sum = _mm_add_ss(sum, _mm_shuffle_ps(sum, sum, 1));
+    return _mm_cvtss_f32(sum);
+}
+
+
+__attribute__((target("avx2")))
+void getDotProductsAvx2(const float *vector, const float *vectors, const size_t count, const size_t length,
+                        float *products)
+{
+    for (size_t index = 0; index < count; ++index)
+    {
+        const float *other = vectors + (index * length);
+        __m256 product = _mm256_setzero_ps();
+        for (size_t element = 0; element < length; element += 8)
+        {
+            product = _mm256_add_ps(product, _mm256_mul_ps(_mm256_load_ps(vector + element), _mm256_load_ps(other + element)));
+        }
+        products[index] = static_cast<float>(getSum(product));
+    }
+}
+
+
+/* Eight columns of a patch row per iteration, the patches touching
+ * the frame borders go through the scalar code */
+__attribute__((target("avx2")))
+void getCrossCorrelationsAvx2(const uint8_t *prevFrame, const uint8_t *nextFrame, const size_t prevStep,
+                              const size_t nextStep, const int width, const int height, const float *prevPoints, const float *nextPoints,
+                              const size_t pointsCount, const int patchSize, double *correlations)
+{
+    for (size_t point = 0; point < pointsCount; ++point)
+    {
+        SubPixelPatch prevPatch = getSubPixelPatch((prevPoints + (2 * point)), patchSize, width, height);
+        SubPixelPatch nextPatch = getSubPixelPatch((nextPoints + (2 * point)), patchSize, width, height);
+        if ((prevPatch.isInside == false) || (nextPatch.isInside == false) || (patchSize < 8))
+        {
+            correlations[point] = getCrossCorrelationScalar(prevFrame, nextFrame, prevStep, nextStep, width, height,
+                                                            prevPatch, nextPatch, patchSize);
+            continue;
+        }
+        const __m256 prevWeights[4] = {_mm256_set1_ps(prevPatch.weights[0]), _mm256_set1_ps(prevPatch.weights[1]),
+                                       _mm256_set1_ps(prevPatch.weights[2]), _mm256_set1_ps(prevPatch.weights[3])};
+        const __m256 nextWeights[4] = {_mm256_set1_ps(nextPatch.weights[0]), _mm256_set1_ps(nextPatch.weights[1]),
+                                       _mm256_set1_ps(nextPatch.weights[2]), _mm256_set1_ps(nextPatch.weights[3])};
+        __m256 sumPrev = _mm256_setzero_ps();
+        __m256 sumNext = _mm256_setzero_ps();
+        __m256 sumProduct = _mm256_setzero_ps();
+        double tailPrev = 0.0;
+        double tailNext = 0.0;
+        double tailProduct = 0.0;
+        for (int row = 0; row < patchSize; ++row)
+        {
+            const uint8_t *prevRow = prevFrame + ((prevPatch.y + row) * prevStep) + prevPatch.x;
+            const uint8_t *nextRow = nextFrame + ((nextPatch.y + row) * nextStep) + nextPatch.x;
+            int column = 0;
+            for (; (column + 8) <= patchSize; column += 8)
+            {
+                __m256 prevValues = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(prevWeights[0], loadPixels(prevRow + column)),
+                                  _mm256_mul_ps(prevWeights[1], loadPixels(prevRow + column + 1))),
+                    _mm256_add_ps(_mm256_mul_ps(prevWeights[2], loadPixels(prevRow + prevStep + column)),
+                                  _mm256_mul_ps(prevWeights[3], loadPixels(prevRow + prevStep + column + 1))));
+                __m256 nextValues = _mm256_add_ps(
+                    _mm256_add_ps(_mm256_mul_ps(nextWeights[0], loadPixels(nextRow + column)),
+                                  _mm256_mul_ps(nextWeights[1], loadPixels(nextRow + column + 1))),
+                    _mm256_add_ps(_mm256_mul_ps(nextWeights[2], loadPixels(nextRow + nextStep + column)),
+                                  _mm256_mul_ps(nextWeights[3], loadPixels(nextRow + nextStep + column + 1))));
+                sumPrev = _mm256_add_ps(sumPrev, prevValues);
+                sumNext = _mm256_add_ps(sumNext, nextValues);
+                sumProduct = _mm256_add_ps(sumProduct, _mm256_mul_ps(prevValues, nextValues));
+            }
+            for (; column < patchSize; ++column)
+            {
+                float prevValue = getSample(prevFrame, prevStep, width, height, prevPatch, column, row);
+                float nextValue = getSample(nextFrame, nextStep, width, height, nextPatch, column, row);
+                tailPrev += prevValue;
+                tailNext += nextValue;
+                tailProduct += prevValue * nextValue;
+            }
+        }
+        double totalPrev = getSum(sumPrev) + tailPrev;
+        double totalNext = getSum(sumNext) + tailNext;
+        double totalProduct = getSum(sumProduct) + tailProduct;
+        correlations[point] = totalProduct - ((totalPrev * totalNext) / (patchSize * patchSize));
+    }
+}
+#endif
+
+
+template<int FERNS, int FEATURES>
+void getPosteriorSumsFor(const int *integralFrame, const int *windowOffsets, const size_t windowsCount,
+                         const int *featureOffsets, const int fernsCount, const int featuresCount,
+                         const uint16_t *posteriors, int *sums)
+{
+#ifdef KERNELS_X86
+    if (isAvx2Enabled() == true)
+    {
+        getPosteriorSumsAvx2<FERNS, FEATURES>(integralFrame, windowOffsets, windowsCount, featureOffsets,
+                                              fernsCount, featuresCount, posteriors, sums);
+        return;
+    }
+#endif
+    getPosteriorSumsScalar<FERNS, FEATURES>(integralFrame, windowOffsets, windowsCount, featureOffsets,
+                                            fernsCount, featuresCount, posteriors, sums);
+}
+
+
+template<int FERNS, int FEATURES>
+void getLeafIndicesFor(const int *integralFrame, const int *windowOffsets, const size_t windowsCount,
+                       const int *featureOffsets, const int fernsCount, const int featuresCount,
+                       int *leafIndices, const size_t stride)
+{
+#ifdef KERNELS_X86
+    if (isAvx2Enabled() == true)
+    {
+        getLeafIndicesAvx2<FERNS, FEATURES>(integralFrame, windowOffsets, windowsCount, featureOffsets,
+                                            fernsCount, featuresCount, leafIndices, stride);
+        return;
+    }
+#endif
+    getLeafIndicesScalar<FERNS, FEATURES>(integralFrame, windowOffsets, windowsCount, featureOffsets,
+                                          fernsCount, featuresCount, leafIndices, stride);
+}
+
+
+struct EnsembleKernels
+{
+    int fernsCount;
+    int featuresCount;
+    void (*getPosteriorSums)(const int *, const int *, const size_t, const int *, const int, const int,
+                             const uint16_t *, int *);
+    void (*getLeafIndices)(const int *, const int *, const size_t, const int *, const int, const int,
+                           int *, const size_t);
+};
+
+
+/* The default 12 x 6 ensemble and the other sizes of the benchmark */
+const EnsembleKernels specializedKernels[] =
+{
+    {12, 6, &getPosteriorSumsFor<12, 6>, &getLeafIndicesFor<12, 6>},
+    {8, 8, &getPosteriorSumsFor<8, 8>, &getLeafIndicesFor<8, 8>},
+    {24, 4, &getPosteriorSumsFor<24, 4>, &getLeafIndicesFor<24, 4>}
+};
+
+const EnsembleKernels genericKernels = {0, 0, &getPosteriorSumsFor<0, 0>, &getLeafIndicesFor<0, 0>};
+
+
+const EnsembleKernels &getEnsembleKernels(const int fernsCount, const int featuresCount)
+{
+    for (const auto &kernels: specializedKernels)
+    {
+        if ((kernels.fernsCount == fernsCount) && (kernels.featuresCount == featuresCount))
+        {
+            return kernels;
+        }
+    }
+    return genericKernels;
+}
+}
+
+
+namespace kernels
+{
+void setSimdEnabled(const bool isEnabled)
+{
+    isSimdAllowed.store(isEnabled);
+}
+
+
+bool isSimdEnabled()
+{
+    return isAvx2Enabled();
+}
+
+
+bool isSpecialized(const int fernsCount, const int featuresCount)
+{
+    return (&getEnsembleKernels(fernsCount, featuresCount) != &genericKernels);
+}
+
+
+void getPosteriorSums(const int *integralFrame, const int *windowOffsets, const size_t windowsCount,
+                      const int *featureOffsets, const int fernsCount, const int featuresCount,
+                      const uint16_t *posteriors, int *sums)
+{
+    getEnsembleKernels(fernsCount, featuresCount).getPosteriorSums(integralFrame, windowOffsets, windowsCount,
+                                                                   featureOffsets, fernsCount, featuresCount,
+                                                                   posteriors, sums);
+}
+
+
+void getLeafIndices(const int *integralFrame, const int *windowOffsets, const size_t windowsCount,
+                    const int *featureOffsets, const int fernsCount, const int featuresCount,
+                    int *leafIndices, const size_t stride)
+{
+    getEnsembleKernels(fernsCount, featuresCount).getLeafIndices(integralFrame, windowOffsets, windowsCount,
+                                                                 featureOffsets, fernsCount, featuresCount,
+                                                                 leafIndices, stride);
+}
+
+
+void getDotProducts(const float *vector, const float *vectors, const size_t count, const size_t length,
+                    float *products)
+{
+#ifdef KERNELS_X86
+    if (isSimdEnabled() == true)
+    {
+        getDotProductsAvx2(vector, vectors, count, length, products);
+        return;
+    }
+#endif
+    getDotProductsScalar(vector, vectors, count, length, products);
+}
+
+
+void getCrossCorrelations(const uint8_t *prevFrame, const uint8_t *nextFrame, const size_t prevStep,
+                          const size_t nextStep, const int width, const int height, const float *prevPoints, const float *nextPoints,
+                          const size_t pointsCount, const int patchSize, double *correlations)
+{
+    if (patchSize <= 0)
+    {
+        std::fill(correlations, (correlations + pointsCount), 0.0);
+        return;
+    }
+#ifdef KERNELS_X86
+    if (isSimdEnabled() == true)
+    {
+        getCrossCorrelationsAvx2(prevFrame, nextFrame, prevStep, nextStep, width, height, prevPoints, nextPoints,
+                                 pointsCount, patchSize, correlations);
+        return;
+    }
+#endif
+    getCrossCorrelationsScalar(prevFrame, nextFrame, prevStep, nextStep, width, height, prevPoints, nextPoints,
+                               pointsCount, patchSize, correlations);
+}
+}
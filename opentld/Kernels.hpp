@@ -0,0 +1,52 @@
+#ifndef KERNELS_HPP
+#define KERNELS_HPP
+
+#include <cstddef>
+#include <cstdint>
+
+
+/* Hot loops with SIMD implementations picked at runtime
+ * from the CPU features and a scalar fallback. */
+namespace kernels
+{
+/* Allows to force the scalar code, e.g. to compare the results */
+void setSimdEnabled(const bool isEnabled);
+bool isSimdEnabled();
+/* True when the ensemble kernels have an instantiation with these counts
+ * fixed at compile time (12 x 6, 8 x 8, 24 x 4), the other sizes run the
+ * generic loops */
+bool isSpecialized(const int fernsCount, const int featuresCount);
+
+/* Ensemble evaluation of windowsCount windows of the same size over an
+ * integral frame of int values. windowOffsets are the offsets of the
+ * windows top-left corners, featureOffsets hold Feature::cornersCount
+ * offsets per feature (fern-major, see Feature::getOffsets()).
+ * posteriors is the fern-major table of 4^featuresCount quantized values
+ * per fern and has to stay readable one element past its end. */
+void getPosteriorSums(const int *integralFrame, const int *windowOffsets, const size_t windowsCount,
+                      const int *featureOffsets, const int fernsCount, const int featuresCount,
+                      const uint16_t *posteriors, int *sums);
+
+/* Fern leaf indices of the same windows, the index of fern f for
+ * window w goes to leafIndices[(f * stride) + w] */
+void getLeafIndices(const int *integralFrame, const int *windowOffsets, const size_t windowsCount,
+                    const int *featureOffsets, const int fernsCount, const int featuresCount,
+                    int *leafIndices, const size_t stride);
+
+/* Dot products of vector with count vectors stored one after another,
+ * length is a multiple of 8 and the arrays are 32-byte aligned */
+void getDotProducts(const float *vector, const float *vectors, const size_t count, const size_t length,
+                    float *products);
+
+/* TM_CCOEFF scores of the patchSize x patchSize patches centered at the
+ * prevPoints in prevFrame and at the nextPoints in nextFrame, sampled
+ * bilinearly with replicated borders like cv::getRectSubPix() but kept
+ * in floats. Both frames are 8-bit single channel of the same width and
+ * height, each with its own row step, the points are interleaved x, y pairs. */
+void getCrossCorrelations(const uint8_t *prevFrame, const uint8_t *nextFrame, const size_t prevStep,
+                          const size_t nextStep, const int width, const int height, const float *prevPoints, const float *nextPoints,
+                          const size_t pointsCount, const int patchSize, double *correlations);
+}
+
+
+#endif /* KERNELS_HPP */
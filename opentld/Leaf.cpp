@@ -1,45 +1,101 @@
 #include "Leaf.hpp"
 
 
+namespace
+{
+const uint64_t positiveStep = (static_cast<uint64_t>(1) << 32);
+const uint64_t negativeStep = 1;
+const uint32_t countLimit = 1000000000;
+
+uint32_t getPositive(const uint64_t counters)
+{
+    return static_cast<uint32_t>(counters >> 32);
+}
+
+uint32_t getNegative(const uint64_t counters)
+{
+    return static_cast<uint32_t>(counters & 0xFFFFFFFF);
+}
+}
+
+
 Leaf::Leaf()
-    : positive(0), negative(0), posterior(0.0) {}
+    : counters(0), isTouched(false) {}
+
+
+bool Leaf::increment(const uint32_t count)
+{
+    uint64_t step = positiveStep * count;
+    uint64_t current = counters.fetch_add(step, std::memory_order_relaxed) + step;
+    if (getPositive(current) >= countLimit)
+    {
+        rescale();
+    }
+    return (isTouched.exchange(true, std::memory_order_relaxed) == false);
+}
 
 
-void Leaf::increment()
+bool Leaf::decrement(const uint32_t count)
 {
-    std::lock_guard<std::mutex> lock(mutex);
-    positive++;
-    if (positive == 1000000000)
+    uint64_t step = negativeStep * count;
+    uint64_t current = counters.fetch_add(step, std::memory_order_relaxed) + step;
+    if (getNegative(current) >= countLimit)
     {
-        positive = static_cast<uint32_t>(round(positive / 1000000.0));
-        negative = static_cast<uint32_t>(round(negative / 1000000.0));
+        rescale();
     }
-    posterior = static_cast<double>(positive) / (positive + negative);
+    return (isTouched.exchange(true, std::memory_order_relaxed) == false);
 }
 
 
-void Leaf::decrement()
+void Leaf::rescale()
 {
-    std::lock_guard<std::mutex> lock(mutex);
-    negative++;
-    if (negative == 1000000000)
+    uint64_t current = counters.load(std::memory_order_relaxed);
+    uint64_t scaled;
+    do
     {
-        positive = static_cast<uint32_t>(round(positive / 1000000.0));
-        negative = static_cast<uint32_t>(round(negative / 1000000.0));
+        if ((getPositive(current) < countLimit) && (getNegative(current) < countLimit))
+        {
+            /* Another thread got here first */
+            return;
+        }
+        uint64_t positive = static_cast<uint64_t>(round(getPositive(current) / 1000000.0));
+        uint64_t negative = static_cast<uint64_t>(round(getNegative(current) / 1000000.0));
+        scaled = (positive << 32) | negative;
     }
-    posterior = static_cast<double>(positive) / (positive + negative);
+    while (counters.compare_exchange_weak(current, scaled, std::memory_order_relaxed) == false);
 }
 
 
-double Leaf::load() const
+double Leaf::update()
 {
+    double posterior = 0.0;
+    uint64_t current = counters.load(std::memory_order_relaxed);
+    uint32_t positive = getPositive(current);
+    uint32_t negative = getNegative(current);
+    if (current != 0)
+    {
+        posterior = static_cast<double>(positive) / (static_cast<double>(positive) + negative);
+    }
+    isTouched.store(false, std::memory_order_relaxed);
     return posterior;
 }
 
 
 void Leaf::reset()
 {
-    positive = 0;
-    negative = 0;
-    posterior = 0.0;
+    counters.store(0, std::memory_order_relaxed);
+    isTouched.store(false, std::memory_order_relaxed);
+}
+
+
+uint64_t Leaf::getCounters() const
+{
+    return counters.load(std::memory_order_relaxed);
+}
+
+
+void Leaf::setCounters(const uint64_t counters)
+{
+    this->counters.store(counters, std::memory_order_relaxed);
+    isTouched.store(false, std::memory_order_relaxed);
 }
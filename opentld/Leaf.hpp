@@ -1,7 +1,7 @@
 #ifndef LEAF_HPP
 #define LEAF_HPP
 
-#include <mutex>
+#include <atomic>
 #include <memory>
 #include <cstdint>
 #include <cmath>
@@ -9,21 +9,29 @@
 #include <iostream>
 
 
+/* Training only touches the packed atomic counters, the posterior
+ * is computed by update() once the training batch is over. */
 class Leaf
 {
 public:
     explicit Leaf();
     ~Leaf() = default;
-    void increment();
-    void decrement();
-    double load() const;
+    /* Both return true for the first update of the leaf in a batch,
+     * count samples at once are added by the bulk training */
+    bool increment(const uint32_t count = 1);
+    bool decrement(const uint32_t count = 1);
+    /* Returns the posterior and clears the touched flag */
+    double update();
     void reset();
+    /* The packed counters as stored in the snapshots */
+    uint64_t getCounters() const;
+    void setCounters(const uint64_t counters);
 
 private:
-    std::mutex mutex;
-    uint32_t positive;
-    uint32_t negative;
-    double posterior;
+    /* Positive count in the high half, negative count in the low half */
+    std::atomic<uint64_t> counters;
+    std::atomic<bool> isTouched;
+    void rescale();
 };
 
 
@@ -0,0 +1,139 @@
+#include "MultiTLDTracker.hpp"
+
+#include <stdexcept>
+
+
+MultiTLDTracker::MultiTLDTracker(const int ferns, const int nodes, const double minFeatureScale, const double maxFeatureScale,
+                                 std::shared_ptr<ThreadPool> pool)
+: pool(pool), ferns(ferns), nodes(nodes), minFeatureScale(minFeatureScale), maxFeatureScale(maxFeatureScale),
+  nextId(0), preprocessingTime(0.0)
+{
+    if (this->pool == nullptr)
+    {
+        this->pool = std::make_shared<ThreadPool>();
+    }
+}
+
+
+int MultiTLDTracker::addTarget(const cv::Rect &targetRect)
+{
+    Target target;
+    target.id = nextId++;
+    target.rect = targetRect;
+    target.tracker = std::make_shared<TLDTracker>(ferns, nodes, minFeatureScale, maxFeatureScale, pool);
+    targets.push_back(target);
+    return target.id;
+}
+
+
+bool MultiTLDTracker::removeTarget(const int id)
+{
+    for (auto iterator = targets.begin(); iterator != targets.end(); ++iterator)
+    {
+        if (iterator->id == id)
+        {
+            targets.erase(iterator);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void MultiTLDTracker::clear()
+{
+    targets.clear();
+}
+
+
+void MultiTLDTracker::update(const cv::Mat &frame, const FrameFormat format, const double timestamp)
+{
+    TLD_TRACE_SCOPE("MultiTLDTracker::update");
+    auto start = std::chrono::steady_clock::now();
+    TLD_TRACE_BEGIN("MultiTLDTracker::preprocessing");
+    FrameContext context(frame, format);
+    if (timestamp >= 0.0)
+    {
+        context.setTimestamp(timestamp);
+    }
+    /* All the targets use the same products of the frame */
+    if (targets.empty() == false)
+    {
+        targets.front().tracker->prepare(context);
+    }
+    TLD_TRACE_END("MultiTLDTracker::preprocessing");
+    double time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    update(context);
+    preprocessingTime = time;
+}
+
+
+void MultiTLDTracker::update(const FrameContext &context)
+{
+    preprocessingTime = 0.0;
+    /* One task per target, the stages of a target spread over the
+     * same pool through the nested parallel calls */
+    pool->parallelFor(targets.size(), [this, &context](const size_t begin, const size_t end)
+    {
+        for (size_t i = begin; i < end; ++i)
+        {
+            TLD_TRACE_SCOPE("MultiTLDTracker::target");
+            Target &target = targets[i];
+            target.rect = target.tracker->getTargetRect(context, target.rect);
+        }
+    }, 1);
+}
+
+
+std::vector<int> MultiTLDTracker::getTargetIds() const
+{
+    std::vector<int> ids;
+    for (const auto &target: targets)
+    {
+        ids.push_back(target.id);
+    }
+    return ids;
+}
+
+
+size_t MultiTLDTracker::getTargetsCount() const
+{
+    return targets.size();
+}
+
+
+cv::Rect MultiTLDTracker::getTargetRect(const int id) const
+{
+    return getTarget(id).rect;
+}
+
+
+cv::Rect MultiTLDTracker::getPredictedRect(const int id) const
+{
+    return getTarget(id).tracker->getPredictedRect();
+}
+
+
+const TLDStatistics &MultiTLDTracker::getStatistics(const int id) const
+{
+    return getTarget(id).tracker->getStatistics();
+}
+
+
+double MultiTLDTracker::getPreprocessingTime() const
+{
+    return preprocessingTime;
+}
+
+
+const MultiTLDTracker::Target &MultiTLDTracker::getTarget(const int id) const
+{
+    for (const auto &target: targets)
+    {
+        if (target.id == id)
+        {
+            return target;
+        }
+    }
+    throw std::out_of_range("MultiTLDTracker: unknown target id");
+}
@@ -0,0 +1,63 @@
+#ifndef MULTITLDTRACKER_HPP
+#define MULTITLDTRACKER_HPP
+
+#include <vector>
+#include <memory>
+#include <chrono>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "ThreadPool.hpp"
+#include "FrameContext.hpp"
+#include "TLDTracker.hpp"
+#include "Trace.hpp"
+
+
+/* Several targets on the same video. Every frame is preprocessed once
+ * and shared, each target keeps its own classifier, detector and Kalman
+ * state, and all the targets run on one thread pool. */
+class MultiTLDTracker
+{
+public:
+    MultiTLDTracker(const int ferns = 12, const int nodes = 6, const double minFeatureScale = 0.2, const double maxFeatureScale = 0.5,
+                    std::shared_ptr<ThreadPool> pool = nullptr);
+    ~MultiTLDTracker() = default;
+    /* The target is learned on the next update(), returns its id */
+    int addTarget(const cv::Rect &targetRect);
+    bool removeTarget(const int id);
+    void clear();
+    /* Tracks all the targets on the frame, see TLDTracker for the timestamp */
+    void update(const cv::Mat &frame, const FrameFormat format = FrameFormat::Rgb, const double timestamp = -1.0);
+    void update(const FrameContext &context);
+    std::vector<int> getTargetIds() const;
+    size_t getTargetsCount() const;
+    /* An empty rect means the target is lost on the last frame */
+    cv::Rect getTargetRect(const int id) const;
+    /* Where the motion of the previous frames put the target on the last
+     * frame, see TLDTracker::getPredictedRect() */
+    cv::Rect getPredictedRect(const int id) const;
+    const TLDStatistics &getStatistics(const int id) const;
+    /* Time of the shared preprocessing of the last frame in milliseconds */
+    double getPreprocessingTime() const;
+
+private:
+    struct Target
+    {
+        int id;
+        cv::Rect rect;
+        std::shared_ptr<TLDTracker> tracker;
+    };
+
+    std::shared_ptr<ThreadPool> pool;
+    int ferns;
+    int nodes;
+    double minFeatureScale;
+    double maxFeatureScale;
+    int nextId;
+    double preprocessingTime;
+    std::vector<Target> targets;
+
+    const Target &getTarget(const int id) const;
+};
+
+#endif /* MULTITLDTRACKER_HPP */
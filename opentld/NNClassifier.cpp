@@ -0,0 +1,174 @@
+#include "NNClassifier.hpp"
+
+
+NNClassifier::NNClassifier(const size_t positivesCapacity, const size_t negativesCapacity)
+{
+    size_t capacity = std::max<size_t>(1, positivesCapacity) + std::max<size_t>(1, negativesCapacity);
+    /* Room to start the templates at a 32-byte boundary */
+    buffer.assign(((capacity * templateLength) + 8), 0.0f);
+    float *templates = buffer.data();
+    while ((reinterpret_cast<uintptr_t>(templates) % 32) != 0)
+    {
+        ++templates;
+    }
+    positives.templates = templates;
+    positives.capacity = std::max<size_t>(1, positivesCapacity);
+    positives.firstReplaced = 1;
+    negatives.templates = templates + (positives.capacity * templateLength);
+    negatives.capacity = std::max<size_t>(1, negativesCapacity);
+    negatives.firstReplaced = 0;
+    reset();
+}
+
+
+void NNClassifier::reset()
+{
+    positives.count = 0;
+    positives.next = 0;
+    negatives.count = 0;
+    negatives.next = 0;
+}
+
+
+double NNClassifier::classify(const cv::Mat &frame, const cv::Rect &rect) const
+{
+    alignas(32) float values[templateLength];
+    if (getTemplate(frame, rect, values) == false)
+    {
+        return 0.0;
+    }
+    return getRelativeSimilarity(values);
+}
+
+
+void NNClassifier::addPositive(const cv::Mat &frame, const cv::Rect &rect)
+{
+    alignas(32) float values[templateLength];
+    if (getTemplate(frame, rect, values) == true)
+    {
+        add(positives, values);
+    }
+}
+
+
+void NNClassifier::addNegative(const cv::Mat &frame, const cv::Rect &rect)
+{
+    alignas(32) float values[templateLength];
+    if (getTemplate(frame, rect, values) == true)
+    {
+        add(negatives, values);
+    }
+}
+
+
+bool NNClassifier::learn(const cv::Mat &frame, const cv::Rect &rect, const bool isPositive)
+{
+    alignas(32) float values[templateLength];
+    if (getTemplate(frame, rect, values) == false)
+    {
+        return false;
+    }
+    double similarity = getRelativeSimilarity(values);
+    if ((isPositive == true) && (similarity < positiveSimilarity))
+    {
+        add(positives, values);
+        return true;
+    }
+    if ((isPositive == false) && (similarity > negativeSimilarity))
+    {
+        add(negatives, values);
+        return true;
+    }
+    return false;
+}
+
+
+size_t NNClassifier::getPositivesCount() const
+{
+    return positives.count;
+}
+
+
+size_t NNClassifier::getNegativesCount() const
+{
+    return negatives.count;
+}
+
+
+size_t NNClassifier::getMemorySize() const
+{
+    return (buffer.size() * sizeof(float));
+}
+
+
+bool NNClassifier::getTemplate(const cv::Mat &frame, const cv::Rect &rect, float *values) const
+{
+    cv::Rect clippedRect = rect & cv::Rect(0, 0, frame.cols, frame.rows);
+    if (clippedRect.area() == 0)
+    {
+        return false;
+    }
+    uint8_t pixels[patchSide * patchSide];
+    cv::Mat patch(patchSide, patchSide, CV_8UC1, pixels);
+    cv::resize(frame(clippedRect), patch, patch.size(), 0, 0, cv::INTER_LINEAR);
+    float mean = 0.0f;
+    for (int i = 0; i < (patchSide * patchSide); ++i)
+    {
+        mean += pixels[i];
+    }
+    mean /= (patchSide * patchSide);
+    float norm = 0.0f;
+    for (int i = 0; i < (patchSide * patchSide); ++i)
+    {
+        values[i] = pixels[i] - mean;
+        norm += values[i] * values[i];
+    }
+    /* A flat window gets the zero template, its NCC with everything is 0 */
+    float scale = ((norm > 0.0f) ? (1.0f / std::sqrt(norm)) : 0.0f);
+    for (int i = 0; i < (patchSide * patchSide); ++i)
+    {
+        values[i] *= scale;
+    }
+    std::fill((values + (patchSide * patchSide)), (values + templateLength), 0.0f);
+    return true;
+}
+
+
+double NNClassifier::getSimilarity(const Store &store, const float *values) const
+{
+    if (store.count == 0)
+    {
+        return 0.0;
+    }
+    /* The best NCC of the store mapped to 0..1 */
+    const size_t chunkSize = 64;
+    float products[chunkSize];
+    float best = -1.0f;
+    for (size_t first = 0; first < store.count; first += chunkSize)
+    {
+        size_t count = std::min(chunkSize, (store.count - first));
+        kernels::getDotProducts(values, (store.templates + (first * templateLength)), count, templateLength, products);
+        best = std::max(best, *(std::max_element(products, (products + count))));
+    }
+    return ((best + 1.0) / 2.0);
+}
+
+
+double NNClassifier::getRelativeSimilarity(const float *values) const
+{
+    double positive = getSimilarity(positives, values);
+    double negative = getSimilarity(negatives, values);
+    if ((positive + negative) == 0.0)
+    {
+        return 0.0;
+    }
+    return (positive / (positive + negative));
+}
+
+
+void NNClassifier::add(Store &store, const float *values)
+{
+    std::copy(values, (values + templateLength), (store.templates + (store.next * templateLength)));
+    store.count = std::min((store.count + 1), store.capacity);
+    store.next = ((store.next + 1) < store.capacity) ? (store.next + 1) : std::min(store.firstReplaced, (store.capacity - 1));
+}
@@ -0,0 +1,64 @@
+#ifndef NNCLASSIFIER_HPP
+#define NNCLASSIFIER_HPP
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "Kernels.hpp"
+#include "Constants.hpp"
+
+
+/* Nearest neighbor verifier: windows are resized to patchSide x patchSide,
+ * normalized to zero mean and unit norm and compared by NCC with bounded
+ * stores of positive and negative templates. The templates live in one
+ * aligned buffer allocated by the constructor, a full store replaces its
+ * oldest template (the first positive, the initial target, stays). */
+class NNClassifier
+{
+public:
+    static const int patchSide = 15;
+    explicit NNClassifier(const size_t positivesCapacity = 100, const size_t negativesCapacity = 100);
+    ~NNClassifier() = default;
+    NNClassifier(const NNClassifier &other) = delete;
+    NNClassifier &operator=(const NNClassifier &other) = delete;
+    void reset();
+    /* Relative similarity in 0..1 of a window of the 8-bit frame,
+     * windows crossing the frame borders are clipped */
+    double classify(const cv::Mat &frame, const cv::Rect &rect) const;
+    void addPositive(const cv::Mat &frame, const cv::Rect &rect);
+    void addNegative(const cv::Mat &frame, const cv::Rect &rect);
+    /* Adds the window only when the stores misjudge it: a positive below
+     * positiveSimilarity or a negative above negativeSimilarity */
+    bool learn(const cv::Mat &frame, const cv::Rect &rect, const bool isPositive);
+    size_t getPositivesCount() const;
+    size_t getNegativesCount() const;
+    /* Bytes of the template buffer */
+    size_t getMemorySize() const;
+
+private:
+    /* Floats per template, padded to the SIMD width */
+    static const size_t templateLength = ((patchSide * patchSide) + 7) & ~static_cast<size_t>(7);
+
+    struct Store
+    {
+        float *templates;
+        size_t capacity;
+        size_t count;
+        size_t next;
+        size_t firstReplaced;
+    };
+
+    std::vector<float> buffer;
+    Store positives;
+    Store negatives;
+
+    bool getTemplate(const cv::Mat &frame, const cv::Rect &rect, float *values) const;
+    double getSimilarity(const Store &store, const float *values) const;
+    double getRelativeSimilarity(const float *values) const;
+    void add(Store &store, const float *values);
+};
+
+#endif /* NNCLASSIFIER_HPP */
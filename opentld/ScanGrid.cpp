@@ -0,0 +1,72 @@
+#include "ScanGrid.hpp"
+
+
+ScanGrid::ScanGrid()
+: patchSize(0, 0), frameSize(0, 0), step(0), squareStep(0) {}
+
+
+bool ScanGrid::update(const Classifier &classifier, const cv::Size &patchSize, const cv::Size &frameSize,
+                      const int step, const int squareStep)
+{
+    if ((scales.empty() == false)
+        && (this->patchSize == patchSize)
+        && (this->frameSize == frameSize)
+        && (this->step == step)
+        && (this->squareStep == squareStep))
+    {
+        return false;
+    }
+    this->patchSize = patchSize;
+    this->frameSize = frameSize;
+    this->step = step;
+    this->squareStep = squareStep;
+
+    std::set<int> widths;
+    std::set<int> heights;
+
+    double minScale = 0.95;
+    double maxScale = 1.05;
+    double scaleStep = 0.05;
+    double stepDevider = 20.0;
+
+    for (double scale = minScale; scale <= maxScale; scale += scaleStep)
+    {
+        widths.insert(static_cast<int>(round(patchSize.width * scale)));
+        heights.insert(static_cast<int>(round(patchSize.height * scale)));
+    }
+
+    scales.clear();
+    for (auto widthIterator = widths.begin(); widthIterator != widths.end(); ++widthIterator)
+    {
+        for (auto heightIterator = heights.begin(); heightIterator != heights.end(); ++heightIterator)
+        {
+            ScanScale scale;
+            scale.size = cv::Size(*widthIterator, *heightIterator);
+            scale.xStep = static_cast<int>(round(scale.size.width / stepDevider));
+            scale.yStep = static_cast<int>(round(scale.size.height / stepDevider));
+            scale.cornerOffsets[0] = 0;
+            scale.cornerOffsets[1] = scale.size.width;
+            scale.cornerOffsets[2] = scale.size.height * step;
+            scale.cornerOffsets[3] = (scale.size.height * step) + scale.size.width;
+            scale.squareCornerOffsets[0] = 0;
+            scale.squareCornerOffsets[1] = scale.size.width;
+            scale.squareCornerOffsets[2] = scale.size.height * squareStep;
+            scale.squareCornerOffsets[3] = (scale.size.height * squareStep) + scale.size.width;
+            classifier.getFeatureOffsets(scale.size, step, scale.featureOffsets);
+            scales.push_back(scale);
+        }
+    }
+    return true;
+}
+
+
+void ScanGrid::reset()
+{
+    scales.clear();
+}
+
+
+const std::vector<ScanScale> &ScanGrid::getScales() const
+{
+    return scales;
+}
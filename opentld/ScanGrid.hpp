@@ -0,0 +1,50 @@
+#ifndef SCANGRID_HPP
+#define SCANGRID_HPP
+
+#include <vector>
+#include <set>
+#include <cmath>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "Classifier.hpp"
+
+
+/* One window size of the scanning grid with everything
+ * the detector needs precomputed as integral frame offsets */
+struct ScanScale
+{
+    cv::Size size;
+    int xStep;
+    int yStep;
+    /* Corners of the window in the integral and the square integral frames */
+    int cornerOffsets[4];
+    int squareCornerOffsets[4];
+    /* Feature::cornersCount offsets per feature, fern-major */
+    std::vector<int> featureOffsets;
+};
+
+
+/* Window sizes scanned around the last patch size. It is rebuilt only
+ * when the patch size or the frame geometry changes. */
+class ScanGrid
+{
+public:
+    ScanGrid();
+    ~ScanGrid() = default;
+    /* Returns true when the scales had to be rebuilt */
+    bool update(const Classifier &classifier, const cv::Size &patchSize, const cv::Size &frameSize,
+                const int step, const int squareStep);
+    /* Forces the rebuild on the next update(), e.g. when the features changed */
+    void reset();
+    const std::vector<ScanScale> &getScales() const;
+
+private:
+    cv::Size patchSize;
+    cv::Size frameSize;
+    int step;
+    int squareStep;
+    std::vector<ScanScale> scales;
+};
+
+#endif /* SCANGRID_HPP */
@@ -0,0 +1,83 @@
+#include "Snapshot.hpp"
+
+#include <cstdio>
+#include <fstream>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+
+namespace snapshot
+{
+MappedFile::MappedFile(const std::string &path)
+    : data(nullptr), size(0)
+{
+    int file = open(path.c_str(), O_RDONLY);
+    if (file < 0)
+    {
+        return;
+    }
+    struct stat status;
+    if ((fstat(file, &status) == 0) && (status.st_size > 0))
+    {
+        void *mapping = mmap(nullptr, static_cast<size_t>(status.st_size), PROT_READ, MAP_PRIVATE, file, 0);
+        if (mapping != MAP_FAILED)
+        {
+            data = mapping;
+            size = static_cast<size_t>(status.st_size);
+        }
+    }
+    /* The mapping stays valid without the descriptor */
+    close(file);
+}
+
+
+MappedFile::~MappedFile()
+{
+    if (data != nullptr)
+    {
+        munmap(data, size);
+    }
+}
+
+
+bool MappedFile::isOpen() const
+{
+    return (data != nullptr);
+}
+
+
+const char *MappedFile::getData() const
+{
+    return static_cast<const char *>(data);
+}
+
+
+size_t MappedFile::getSize() const
+{
+    return size;
+}
+
+
+bool writeFile(const std::string &path, const std::vector<char> &bytes)
+{
+    std::string temporaryPath = path + ".tmp";
+    {
+        std::ofstream file(temporaryPath, std::ios::binary | std::ios::trunc);
+        if (file.is_open() == false)
+        {
+            return false;
+        }
+        file.write(bytes.data(), static_cast<std::streamsize>(bytes.size()));
+        file.close();
+        if (file.fail() == true)
+        {
+            std::remove(temporaryPath.c_str());
+            return false;
+        }
+    }
+    return (std::rename(temporaryPath.c_str(), path.c_str()) == 0);
+}
+}
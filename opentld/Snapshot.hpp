@@ -0,0 +1,138 @@
+#ifndef SNAPSHOT_HPP
+#define SNAPSHOT_HPP
+
+#include <vector>
+#include <string>
+#include <cstring>
+#include <cstdint>
+#include <type_traits>
+
+
+/* Binary snapshots of the tracker state. The values are stored in the host
+ * byte order, the tables start at tableAlignment boundaries so a reader
+ * over a mapped file can use them in place. */
+namespace snapshot
+{
+/* Bumped with every layout change, files of other versions are rejected */
+const uint32_t version = 2;
+const size_t tableAlignment = 64;
+
+
+class Writer
+{
+public:
+    template<class T>
+    void write(const T &value)
+    {
+        writeArray(&value, 1);
+    }
+
+    template<class T>
+    void writeArray(const T *values, const size_t count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values are copied as bytes");
+        const char *begin = reinterpret_cast<const char *>(values);
+        bytes.insert(bytes.end(), begin, (begin + (sizeof(T) * count)));
+    }
+
+    void align()
+    {
+        bytes.resize((((bytes.size() + tableAlignment) - 1) / tableAlignment) * tableAlignment, 0);
+    }
+
+    std::vector<char> &getBytes()
+    {
+        return bytes;
+    }
+
+private:
+    std::vector<char> bytes;
+};
+
+
+/* Once a read runs past the end every further read fails as well,
+ * so the callers check isValid() only before applying the values */
+class Reader
+{
+public:
+    Reader(const char *data, const size_t size)
+        : data(data), size(size), position(0), isFailed(false) {}
+
+    template<class T>
+    bool read(T &value)
+    {
+        return readArray(&value, 1);
+    }
+
+    template<class T>
+    bool readArray(T *values, const size_t count)
+    {
+        const T *table = getTable<T>(count);
+        if (table != nullptr)
+        {
+            std::memcpy(values, table, (sizeof(T) * count));
+        }
+        return (table != nullptr);
+    }
+
+    /* Points into the data, nullptr when it is too short */
+    template<class T>
+    const T *getTable(const size_t count)
+    {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshot values are copied as bytes");
+        if ((isFailed == true) || (count > ((size - position) / sizeof(T))))
+        {
+            isFailed = true;
+            return nullptr;
+        }
+        const T *table = reinterpret_cast<const T *>(data + position);
+        position += sizeof(T) * count;
+        return table;
+    }
+
+    void align()
+    {
+        position = (((position + tableAlignment) - 1) / tableAlignment) * tableAlignment;
+        if (position > size)
+        {
+            isFailed = true;
+            position = size;
+        }
+    }
+
+    bool isValid() const
+    {
+        return (isFailed == false);
+    }
+
+private:
+    const char *data;
+    size_t size;
+    size_t position;
+    bool isFailed;
+};
+
+
+/* Read-only private mapping of a whole file */
+class MappedFile
+{
+public:
+    explicit MappedFile(const std::string &path);
+    ~MappedFile();
+    MappedFile(const MappedFile &other) = delete;
+    MappedFile &operator=(const MappedFile &other) = delete;
+    bool isOpen() const;
+    const char *getData() const;
+    size_t getSize() const;
+
+private:
+    void *data;
+    size_t size;
+};
+
+
+/* Writes a temporary file and renames it, so the path always holds a whole snapshot */
+bool writeFile(const std::string &path, const std::vector<char> &bytes);
+}
+
+#endif /* SNAPSHOT_HPP */
@@ -1,36 +1,119 @@
 #include "TLDTracker.hpp"
 
 
-TLDTracker::TLDTracker(const int ferns, const int nodes, const double minFeatureScale, const double maxFeatureScale)
-: lastConfidence(1.0), isInitialised(false)
+namespace
 {
-    classifier = std::make_shared<Classifier>(ferns, nodes, minFeatureScale, maxFeatureScale);
-    detector = std::make_shared<Detector>(classifier);
+const char snapshotMagic[8] = {'O', 'p', 'e', 'n', 'T', 'L', 'D', 0};
+const uint32_t byteOrderMark = 0x01020304;
+/* Pixels around the search region, covers the correlation patches
+ * and the rotated positive warps near its borders */
+const int regionMargin = 16;
+
+double getElapsedTime(const std::chrono::steady_clock::time_point &start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+}
+
+
+TLDTracker::TLDTracker(const int ferns, const int nodes, const double minFeatureScale, const double maxFeatureScale,
+                       std::shared_ptr<ThreadPool> pool)
+: pool(pool), lastConfidence(1.0), lastRect(0, 0, 0, 0), isInitialised(false), isTrackerStarted(false),
+  isRegionPreprocessingEnabled(false)
+{
+    if (this->pool == nullptr)
+    {
+        this->pool = std::make_shared<ThreadPool>();
+    }
+    classifier = std::make_shared<Classifier>(ferns, nodes, minFeatureScale, maxFeatureScale, this->pool);
+    detector = std::make_shared<Detector>(classifier, this->pool);
     tracker = std::make_shared<Tracker>(classifier);
 }
 
 
-cv::Rect TLDTracker::getTargetRect(cv::Mat &frameRGB, const cv::Rect &targetRect)
+cv::Rect TLDTracker::getTargetRect(const cv::Mat &frame, const cv::Rect &targetRect, const FrameFormat format,
+                                   const double timestamp)
+{
+    TLD_TRACE_SCOPE("TLDTracker::getTargetRect");
+    FrameContext context(frame, format);
+    return getPreparedTargetRect(context, targetRect, timestamp);
+}
+
+
+cv::Rect TLDTracker::getTargetRect(const uint8_t *luma, const int width, const int height, const size_t stride,
+                                   const cv::Rect &targetRect, const FrameFormat format, const double timestamp)
 {
-    cv::Mat frame;
-    cv::cvtColor(frameRGB, frame, cv::COLOR_RGB2GRAY);
-    //    frame.convertTo(frame, -1, 2, 3);
-    cv::blur(frame, frame, cv::Size(3, 3));
-    cv::Mat integralFrame;
-    cv::integral(frame, integralFrame);
+    TLD_TRACE_SCOPE("TLDTracker::getTargetRect");
+    FrameContext context(luma, width, height, stride, format);
+    return getPreparedTargetRect(context, targetRect, timestamp);
+}
+
+
+cv::Rect TLDTracker::getPreparedTargetRect(FrameContext &context, const cv::Rect &targetRect, const double timestamp)
+{
+    if (timestamp >= 0.0)
+    {
+        context.setTimestamp(timestamp);
+    }
+    auto stageStart = std::chrono::steady_clock::now();
+    TLD_TRACE_BEGIN("TLDTracker::preprocessing");
+    if (isRegionPreprocessingEnabled == true)
+    {
+        context.setRegion(getSearchRegion(cv::Size(context.getWidth(), context.getHeight()), targetRect));
+    }
+    prepare(context);
+    TLD_TRACE_END("TLDTracker::preprocessing");
+    double preprocessingTime = getElapsedTime(stageStart);
+    cv::Rect result = getTargetRect(context, targetRect);
+    statistics.preprocessingTime = preprocessingTime;
+    return result;
+}
+
+
+void TLDTracker::prepare(const FrameContext &context) const
+{
+    context.getFrame();
+    context.getSquareIntegral();
+    tracker->prepare(context);
+}
+
+
+cv::Rect TLDTracker::getTargetRect(const FrameContext &context, const cv::Rect &targetRect)
+{
+    statistics = TLDStatistics();
+    auto stageStart = std::chrono::steady_clock::now();
     Patch trackedPatch;
     if (isInitialised == false) {
-        classifier->init(frame, targetRect);
-        detector->init(frame, targetRect);
-        tracker->init(frame);
+        stageStart = std::chrono::steady_clock::now();
+        TLD_TRACE_BEGIN("TLDTracker::initialization");
+        classifier->init(context, targetRect);
+        detector->init(context, targetRect);
+        tracker->init(context);
+        if (verifier != nullptr)
+        {
+            verifier->reset();
+            verifier->addPositive(context.getFrame(), targetRect);
+        }
+        detector->setRedetection(false);
         lastConfidence = 1.0;
         trackedPatch.rect = targetRect;
         isInitialised = true;
+        isTrackerStarted = true;
+        TLD_TRACE_END("TLDTracker::initialization");
+        statistics.learningTime = getElapsedTime(stageStart);
     } else {
         std::vector<Patch> detectedPatches;
-        if ((lastConfidence > trackingConfidence) && (targetRect.area() > 0))
+        stageStart = std::chrono::steady_clock::now();
+        TLD_TRACE_BEGIN("TLDTracker::tracking");
+        if (isTrackerStarted == false)
         {
-            Patch patch = tracker->track(frame, targetRect);
+            /* Restored from a snapshot, there is no previous frame to track from */
+            tracker->init(context);
+            isTrackerStarted = true;
+        }
+        else if ((lastConfidence > trackingConfidence) && (targetRect.area() > 0))
+        {
+            Patch patch = tracker->track(context, targetRect);
             if ((patch.rect.width >= static_cast<int>(round(targetRect.width * 0.85)))
                 && (patch.rect.width <= static_cast<int>(round(targetRect.width * 1.15)))
                 && (patch.rect.height >= static_cast<int>(round(targetRect.height * 0.85)))
@@ -39,7 +122,11 @@ cv::Rect TLDTracker::getTargetRect(cv::Mat &frameRGB, const cv::Rect &targetRect
                 trackedPatch = patch;
             }
         }
-        detector->detect(frame, targetRect, detectedPatches);
+        TLD_TRACE_END("TLDTracker::tracking");
+        statistics.trackingTime = getElapsedTime(stageStart);
+        stageStart = std::chrono::steady_clock::now();
+        TLD_TRACE_BEGIN("TLDTracker::detection");
+        detector->detect(context, targetRect, detectedPatches);
         float maxDetectedConfidence = 0.0;
         int maxDetectedConfidenceIndex = -1;
         for (size_t i = 0; i < detectedPatches.size(); ++i)
@@ -61,13 +148,17 @@ cv::Rect TLDTracker::getTargetRect(cv::Mat &frameRGB, const cv::Rect &targetRect
                 }
             }
         }
-        std::cout << "maxDetectedConfidence = " << maxDetectedConfidence << std::endl;
+        TLD_TRACE_COUNTER("TLDTracker::maxDetectedConfidence", maxDetectedConfidence);
         if (((trackedPatch.confidence < reinitConfidence)
             && (maxDetectedConfidence >= reinitConfidence))
             || (trackedPatch.confidence < maxDetectedConfidence))
         {
             trackedPatch = detectedPatches.at(maxDetectedConfidenceIndex);
         }
+        TLD_TRACE_END("TLDTracker::detection");
+        statistics.detectionTime = getElapsedTime(stageStart);
+        stageStart = std::chrono::steady_clock::now();
+        TLD_TRACE_BEGIN("TLDTracker::learning");
         if (targetRect.area() > 0)
         {
             if ((trackedPatch.confidence >= learningConfidence)
@@ -78,8 +169,14 @@ cv::Rect TLDTracker::getTargetRect(cv::Mat &frameRGB, const cv::Rect &targetRect
                      && (trackedPatch.rect.height >= static_cast<int>(round(targetRect.height * 0.9)))
                      && (trackedPatch.rect.height <= static_cast<int>(round(targetRect.height * 1.1))))*/)
             {
-                classifier->trainPositive(frame, trackedPatch.rect);
+                classifier->trainPositive(context, trackedPatch.rect);
+                if (verifier != nullptr)
+                {
+                    verifier->learn(context.getFrame(), trackedPatch.rect, true);
+                }
             }
+            negativeRects.clear();
+            negativeConfidences.clear();
             for (size_t i = 0; i < detectedPatches.size(); ++i)
             {
                 if ((detectedPatches.at(i).confidence < negativeConfidence)
@@ -88,17 +185,190 @@ cv::Rect TLDTracker::getTargetRect(cv::Mat &frameRGB, const cv::Rect &targetRect
                     || ((trackedPatch.rect.area() < static_cast<int>(round(targetRect.area() * 0.85)))
                         || (trackedPatch.rect.area() > static_cast<int>(round(targetRect.area() * 1.15))))*/)
                 {
-                    classifier->train(integralFrame, detectedPatches.at(i).rect, false);
+                    negativeRects.push_back(detectedPatches.at(i).rect);
+                    negativeConfidences.push_back(detectedPatches.at(i).confidence);
+                }
+            }
+            classifier->trainHardNegatives(context.getIntegral(), negativeRects, negativeConfidences);
+            classifier->update();
+            if ((verifier != nullptr) && (trackedPatch.rect.area() > 0))
+            {
+                /* The verified detections away from the target teach the verifier */
+                for (const auto &patch: detectedPatches)
+                {
+                    if ((patch.confidence >= negativeConfidence)
+                        && (classifier->getRectsOverlap(trackedPatch.rect, patch.rect) < 0.2))
+                    {
+                        verifier->learn(context.getFrame(), patch.rect, false);
+                    }
                 }
             }
         }
+        TLD_TRACE_END("TLDTracker::learning");
+        statistics.learningTime = getElapsedTime(stageStart);
         lastConfidence = trackedPatch.confidence;
+        /* The search around the last patch widens too slowly for a target
+         * which reappears elsewhere, the next frames scan the whole frame */
+        detector->setRedetection(lastConfidence < redetectionConfidence);
     }
+    statistics.confidence = lastConfidence;
+    TLD_TRACE_COUNTER("TLDTracker::confidence", lastConfidence);
+    lastRect = trackedPatch.rect;
     return trackedPatch.rect;
 }
 
 
+void TLDTracker::setScaleEstimation(const ScaleEstimation mode, const size_t maxPairs)
+{
+    tracker->setScaleEstimation(mode, maxPairs);
+}
+
+
+void TLDTracker::setRedetectionBudget(const size_t windowsPerFrame)
+{
+    detector->setRedetectionBudget(windowsPerFrame);
+}
+
+
+void TLDTracker::setHardNegativesBudget(const size_t budget)
+{
+    classifier->setHardNegativesBudget(budget);
+}
+
+
+void TLDTracker::setNegativeSamplesLimit(const size_t limit)
+{
+    classifier->setNegativeSamplesLimit(limit);
+}
+
+
+void TLDTracker::setVerification(const bool isEnabled, const size_t positivesCapacity, const size_t negativesCapacity)
+{
+    verifier = ((isEnabled == true) ? std::make_shared<NNClassifier>(positivesCapacity, negativesCapacity) : nullptr);
+    detector->setVerifier(verifier);
+}
+
+
+void TLDTracker::setRegionPreprocessing(const bool isEnabled)
+{
+    isRegionPreprocessingEnabled = isEnabled;
+}
+
+
+cv::Rect TLDTracker::getSearchRegion(const cv::Size &frameSize, const cv::Rect &targetRect) const
+{
+    cv::Rect frameRect(cv::Point(0, 0), frameSize);
+    if ((isInitialised == false) || (detector->isRedetecting() == true) || (targetRect.area() == 0))
+    {
+        return frameRect;
+    }
+    /* The optical flow follows the target up to half of its size */
+    cv::Rect region((targetRect.x - (targetRect.width / 2)), (targetRect.y - (targetRect.height / 2)),
+                    (targetRect.width * 2), (targetRect.height * 2));
+    region |= detector->getSearchRegion(targetRect);
+    region = cv::Rect((region.x - regionMargin), (region.y - regionMargin),
+                      (region.width + (2 * regionMargin)), (region.height + (2 * regionMargin)));
+    return (region & frameRect);
+}
+
+
 void TLDTracker::resetTracker()
 {
     isInitialised = false;
 }
+
+
+const TLDStatistics &TLDTracker::getStatistics() const
+{
+    return statistics;
+}
+
+
+const cv::Rect &TLDTracker::getLastRect() const
+{
+    return lastRect;
+}
+
+
+cv::Rect TLDTracker::getPredictedRect() const
+{
+    return detector->getPredictedRect();
+}
+
+
+std::vector<char> TLDTracker::getSnapshot() const
+{
+    TLD_TRACE_SCOPE("TLDTracker::getSnapshot");
+    snapshot::Writer writer;
+    writer.writeArray(snapshotMagic, sizeof(snapshotMagic));
+    writer.write(snapshot::version);
+    writer.write(byteOrderMark);
+    writer.write(static_cast<uint8_t>(isInitialised));
+    writer.write(lastConfidence);
+    int rect[4] = {lastRect.x, lastRect.y, lastRect.width, lastRect.height};
+    writer.writeArray(rect, 4);
+    classifier->save(writer);
+    detector->save(writer);
+    return std::move(writer.getBytes());
+}
+
+
+bool TLDTracker::saveSnapshot(const std::string &path) const
+{
+    return snapshot::writeFile(path, getSnapshot());
+}
+
+
+std::future<bool> TLDTracker::saveSnapshotAsync(const std::string &path) const
+{
+    return std::async(std::launch::async, [path](const std::vector<char> &bytes)
+    {
+        TLD_TRACE_SCOPE("TLDTracker::saveSnapshot");
+        return snapshot::writeFile(path, bytes);
+    }, getSnapshot());
+}
+
+
+bool TLDTracker::loadSnapshot(const std::string &path)
+{
+    TLD_TRACE_SCOPE("TLDTracker::loadSnapshot");
+    snapshot::MappedFile file(path);
+    return ((file.isOpen() == true) && (loadSnapshot(file.getData(), file.getSize()) == true));
+}
+
+
+bool TLDTracker::loadSnapshot(const char *data, const size_t size)
+{
+    snapshot::Reader reader(data, size);
+    char magic[sizeof(snapshotMagic)];
+    uint32_t savedVersion = 0;
+    uint32_t savedByteOrderMark = 0;
+    uint8_t savedIsInitialised = 0;
+    double savedLastConfidence = 0.0;
+    int rect[4] = {0, 0, 0, 0};
+    reader.readArray(magic, sizeof(magic));
+    reader.read(savedVersion);
+    reader.read(savedByteOrderMark);
+    reader.read(savedIsInitialised);
+    reader.read(savedLastConfidence);
+    reader.readArray(rect, 4);
+    /* Every section is checked before any of them is applied */
+    Classifier::SnapshotTables classifierTables;
+    Detector::SnapshotState detectorState;
+    if ((reader.isValid() == false)
+        || (std::memcmp(magic, snapshotMagic, sizeof(magic)) != 0)
+        || (savedVersion != snapshot::version)
+        || (savedByteOrderMark != byteOrderMark)
+        || (classifier->readSnapshot(reader, classifierTables) == false)
+        || (detector->readSnapshot(reader, detectorState) == false))
+    {
+        return false;
+    }
+    classifier->applySnapshot(classifierTables);
+    detector->applySnapshot(detectorState);
+    isInitialised = (savedIsInitialised != 0);
+    isTrackerStarted = false;
+    lastConfidence = savedLastConfidence;
+    lastRect = cv::Rect(rect[0], rect[1], rect[2], rect[3]);
+    return true;
+}
@@ -3,30 +3,116 @@
 
 #include <vector>
 #include <memory>
+#include <chrono>
+#include <string>
+#include <future>
 
 #include <opencv2/imgproc/imgproc.hpp>
 
+#include "ThreadPool.hpp"
 #include "Classifier.hpp"
 #include "Patch.hpp"
+#include "FrameContext.hpp"
 #include "Tracker.hpp"
 #include "Detector.hpp"
+#include "Trace.hpp"
+#include "Snapshot.hpp"
 #include "Constants.hpp"
 
 
+/* Outcome of the last getTargetRect() call, the times are in milliseconds */
+struct TLDStatistics
+{
+    TLDStatistics()
+        : confidence(0.0), preprocessingTime(0.0), trackingTime(0.0), detectionTime(0.0), learningTime(0.0) {}
+    double confidence;
+    double preprocessingTime;
+    double trackingTime;
+    double detectionTime;
+    double learningTime;
+};
+
+
 class TLDTracker
 {
 public:
-    TLDTracker(const int ferns = 12, const int nodes = 6, const double minFeatureScale = 0.2, const double maxFeatureScale = 0.5);
+    TLDTracker(const int ferns = 12, const int nodes = 6, const double minFeatureScale = 0.2, const double maxFeatureScale = 0.5,
+               std::shared_ptr<ThreadPool> pool = nullptr);
     ~TLDTracker() = default;
-    cv::Rect getTargetRect(cv::Mat &frameRGB, const cv::Rect &targetRect);
+    /* timestamp is the frame time in seconds (e.g. its position in the video)
+     * the motion prediction steps by, a negative one takes the steady clock */
+    cv::Rect getTargetRect(const cv::Mat &frame, const cv::Rect &targetRect, const FrameFormat format = FrameFormat::Rgb,
+                           const double timestamp = -1.0);
+    /* Zero-copy input of a luma plane (see FrameContext) */
+    cv::Rect getTargetRect(const uint8_t *luma, const int width, const int height, const size_t stride,
+                           const cv::Rect &targetRect, const FrameFormat format = FrameFormat::Luma,
+                           const double timestamp = -1.0);
+    /* Same on a frame preprocessed by the caller, e.g. shared between
+     * several trackers; the preprocessing time is left at zero */
+    cv::Rect getTargetRect(const FrameContext &context, const cv::Rect &targetRect);
+    /* Computes all the frame products the stages use, so the preprocessing
+     * of the next frame can overlap with getTargetRect() on the current one */
+    void prepare(const FrameContext &context) const;
     void resetTracker();
+    void setScaleEstimation(const ScaleEstimation mode, const size_t maxPairs = 2048);
+    /* Windows per frame of the full-frame re-detection, which runs while
+     * the confidence stays below redetectionConfidence */
+    void setRedetectionBudget(const size_t windowsPerFrame);
+    /* Negatives learned per frame, see Classifier::trainHardNegatives() */
+    void setHardNegativesBudget(const size_t budget);
+    /* Cap of the negative windows trained at the initialization,
+     * see Classifier::setNegativeSamplesLimit() */
+    void setNegativeSamplesLimit(const size_t limit);
+    /* Nearest neighbor verification of the detections (off by default),
+     * the stores learn from the next learning frames */
+    void setVerification(const bool isEnabled, const size_t positivesCapacity = 100,
+                         const size_t negativesCapacity = 100);
+    /* Off by default. While tracking, the frames passed to getTargetRect() are
+     * converted, blurred and integrated only over getSearchRegion(); the first
+     * frame and the frames of the full-frame re-detection stay whole. */
+    void setRegionPreprocessing(const bool isEnabled);
+    /* Part of a frame of frameSize the next getTargetRect() call reads: the
+     * detector windows and the optical flow around the target plus a margin.
+     * Callers preparing a shared FrameContext may restrict it to the union. */
+    cv::Rect getSearchRegion(const cv::Size &frameSize, const cv::Rect &targetRect) const;
+    const TLDStatistics &getStatistics() const;
+    /* The rect returned by the last getTargetRect() call */
+    const cv::Rect &getLastRect() const;
+    /* Where the Kalman filter of the detector put the target on the last
+     * frame, also while it is lost (empty after KalmanFilter::maxLostFrames) */
+    cv::Rect getPredictedRect() const;
+    /* Versioned binary snapshot of the learned model and the tracking
+     * state; taking it costs a copy of the fern tables */
+    std::vector<char> getSnapshot() const;
+    bool saveSnapshot(const std::string &path) const;
+    /* Takes the snapshot on the calling thread and writes it on another one,
+     * the destructor of the future waits for the write */
+    std::future<bool> saveSnapshotAsync(const std::string &path) const;
+    /* The file is mapped and the tables are copied straight from the mapping.
+     * Returns false and keeps the state for a missing, malformed, truncated or
+     * incompatible (other version, ferns or nodes) snapshot.
+     * The optical flow restarts from the next frame. */
+    bool loadSnapshot(const std::string &path);
+    bool loadSnapshot(const char *data, const size_t size);
 
 private:
+    std::shared_ptr<ThreadPool> pool;
     std::shared_ptr<Classifier> classifier;
     std::shared_ptr<Detector> detector;
     std::shared_ptr<Tracker> tracker;
+    std::shared_ptr<NNClassifier> verifier;
     double lastConfidence;
+    cv::Rect lastRect;
     bool isInitialised;
+    bool isTrackerStarted;
+    bool isRegionPreprocessingEnabled;
+    TLDStatistics statistics;
+    /* Negative candidates of the learning stage */
+    std::vector<cv::Rect> negativeRects;
+    std::vector<double> negativeConfidences;
+
+    /* getTargetRect() with the preprocessing timed */
+    cv::Rect getPreparedTargetRect(FrameContext &context, const cv::Rect &targetRect, const double timestamp);
 };
 
 #endif /* TLDTRACKER_HPP */
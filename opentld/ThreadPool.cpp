@@ -0,0 +1,206 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <string>
+
+#include "Trace.hpp"
+
+
+namespace
+{
+thread_local const ThreadPool *currentPool = nullptr;
+thread_local size_t currentQueue = 0;
+
+struct Batch
+{
+    explicit Batch(const size_t chunksCount)
+        : pending(chunksCount), isDone(false) {}
+    std::atomic<size_t> pending;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool isDone;
+    std::exception_ptr exception;
+};
+}
+
+
+ThreadPool::ThreadPool(const size_t threadsCount)
+    : queuedTasks(0), nextQueue(0), isStopping(false)
+{
+    for (size_t thread = 0; thread < threadsCount; ++thread)
+    {
+        queues.push_back(std::unique_ptr<WorkQueue>(new WorkQueue));
+    }
+    for (size_t thread = 0; thread < threadsCount; ++thread)
+    {
+        workers.push_back(std::thread(&ThreadPool::run, this, thread));
+    }
+}
+
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        isStopping = true;
+    }
+    sleepCondition.notify_all();
+    for (auto &worker: workers)
+    {
+        worker.join();
+    }
+}
+
+
+size_t ThreadPool::getThreadsCount() const
+{
+    return workers.size();
+}
+
+
+size_t ThreadPool::getDefaultThreadsCount()
+{
+    /* The thread calling parallelFor() works too */
+    size_t hardwareThreads = std::thread::hardware_concurrency();
+    return ((hardwareThreads > 1) ? (hardwareThreads - 1) : 0);
+}
+
+
+void ThreadPool::parallelFor(const size_t count, const std::function<void(const size_t, const size_t)> &body,
+                             const size_t grainSize)
+{
+    size_t grain = grainSize;
+    if (grain == 0)
+    {
+        grain = std::max<size_t>(1, count / ((workers.size() + 1) * 4));
+    }
+    size_t chunksCount = (count + grain - 1) / grain;
+    if ((workers.empty() == true) || (chunksCount < 2))
+    {
+        if (count > 0)
+        {
+            body(0, count);
+        }
+        return;
+    }
+
+    Batch batch(chunksCount);
+    auto runChunk = [&batch, &body](const size_t begin, const size_t end)
+    {
+        try
+        {
+            TLD_TRACE_SCOPE("ThreadPool::chunk");
+            body(begin, end);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            if (batch.exception == nullptr)
+            {
+                batch.exception = std::current_exception();
+            }
+        }
+        if (batch.pending.fetch_sub(1) == 1)
+        {
+            std::lock_guard<std::mutex> lock(batch.mutex);
+            batch.isDone = true;
+            batch.condition.notify_all();
+        }
+    };
+
+    for (size_t chunk = 1; chunk < chunksCount; ++chunk)
+    {
+        size_t begin = chunk * grain;
+        size_t end = std::min(count, (begin + grain));
+        push(std::bind(runChunk, begin, end));
+    }
+    runChunk(0, std::min(count, grain));
+
+    size_t index = getCurrentQueue();
+    while ((batch.pending.load() > 0) && (tryRunTask(index) == true))
+    {
+    }
+    std::unique_lock<std::mutex> lock(batch.mutex);
+    batch.condition.wait(lock, [&batch] { return batch.isDone; });
+    if (batch.exception != nullptr)
+    {
+        std::rethrow_exception(batch.exception);
+    }
+}
+
+
+void ThreadPool::run(const size_t index)
+{
+    currentPool = this;
+    currentQueue = index;
+    TLD_TRACE_THREAD_NAME("worker " + std::to_string(index));
+    while (true)
+    {
+        if (tryRunTask(index) == false)
+        {
+            std::unique_lock<std::mutex> lock(sleepMutex);
+            sleepCondition.wait(lock, [this] { return ((isStopping == true) || (queuedTasks.load() > 0)); });
+            if ((isStopping == true) && (queuedTasks.load() == 0))
+            {
+                break;
+            }
+        }
+    }
+}
+
+
+void ThreadPool::push(std::function<void()> task)
+{
+    size_t index = getCurrentQueue();
+    if (index == queues.size())
+    {
+        index = nextQueue.fetch_add(1) % queues.size();
+    }
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        ++queuedTasks;
+    }
+    {
+        std::lock_guard<std::mutex> lock(queues.at(index)->mutex);
+        queues.at(index)->tasks.push_back(std::move(task));
+    }
+    sleepCondition.notify_one();
+}
+
+
+bool ThreadPool::tryRunTask(const size_t index)
+{
+    std::function<void()> task;
+    if (index < queues.size())
+    {
+        std::lock_guard<std::mutex> lock(queues.at(index)->mutex);
+        if (queues.at(index)->tasks.empty() == false)
+        {
+            task = std::move(queues.at(index)->tasks.back());
+            queues.at(index)->tasks.pop_back();
+        }
+    }
+    for (size_t offset = 1; ((task == nullptr) && (offset <= queues.size())); ++offset)
+    {
+        WorkQueue &victim = *(queues.at((index + offset) % queues.size()));
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty() == false)
+        {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+        }
+    }
+    if (task == nullptr)
+    {
+        return false;
+    }
+    --queuedTasks;
+    task();
+    return true;
+}
+
+
+size_t ThreadPool::getCurrentQueue() const
+{
+    return ((currentPool == this) ? currentQueue : queues.size());
+}
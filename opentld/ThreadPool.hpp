@@ -0,0 +1,55 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <exception>
+
+
+/* Long-lived pool of worker threads with one task queue per worker.
+ * Workers pop their own queue from the back and steal from the front
+ * of the others. A thread waiting in parallelFor() runs queued tasks
+ * itself until its range is done, so nested calls cannot deadlock. */
+class ThreadPool
+{
+public:
+    explicit ThreadPool(const size_t threadsCount = getDefaultThreadsCount());
+    ~ThreadPool();
+    ThreadPool(const ThreadPool &other) = delete;
+    ThreadPool &operator=(const ThreadPool &other) = delete;
+    size_t getThreadsCount() const;
+    /* Splits [0, count) into chunks of grainSize elements (0 selects a grain
+     * from the threads count), runs body(begin, end) for every chunk and
+     * blocks until all of them are done. */
+    void parallelFor(const size_t count, const std::function<void(const size_t, const size_t)> &body,
+                     const size_t grainSize = 0);
+    static size_t getDefaultThreadsCount();
+
+private:
+    struct WorkQueue
+    {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    std::vector<std::unique_ptr<WorkQueue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable sleepCondition;
+    std::atomic<size_t> queuedTasks;
+    std::atomic<size_t> nextQueue;
+    bool isStopping;
+
+    void run(const size_t index);
+    void push(std::function<void()> task);
+    bool tryRunTask(const size_t index);
+    size_t getCurrentQueue() const;
+};
+
+#endif /* THREADPOOL_HPP */
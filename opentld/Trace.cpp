@@ -0,0 +1,249 @@
+#include "Trace.hpp"
+
+#include <fstream>
+
+#ifdef OPENTLD_TRACING
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <iomanip>
+
+
+namespace
+{
+struct Event
+{
+    const char *name;
+    int64_t time;
+    double value;
+    char phase;
+};
+
+
+/* Only its own thread writes a buffer, the mutex is contended
+ * just while an export or a clear() is running */
+struct ThreadBuffer
+{
+    std::mutex mutex;
+    std::vector<Event> events;
+    size_t next;
+    bool isFull;
+    size_t id;
+    std::string name;
+};
+
+
+struct Registry
+{
+    Registry()
+        : bufferSize(1 << 16), start(std::chrono::steady_clock::now()) {}
+    std::mutex mutex;
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    std::atomic<size_t> bufferSize;
+    const std::chrono::steady_clock::time_point start;
+};
+
+
+Registry &getRegistry()
+{
+    static Registry registry;
+    return registry;
+}
+
+
+ThreadBuffer &getThreadBuffer()
+{
+    thread_local std::shared_ptr<ThreadBuffer> buffer;
+    if (buffer == nullptr)
+    {
+        Registry &registry = getRegistry();
+        buffer = std::make_shared<ThreadBuffer>();
+        buffer->events.resize(std::max<size_t>(1, registry.bufferSize.load()));
+        buffer->next = 0;
+        buffer->isFull = false;
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        buffer->id = registry.buffers.size();
+        buffer->name = "thread " + std::to_string(buffer->id);
+        registry.buffers.push_back(buffer);
+    }
+    return *buffer;
+}
+
+
+void record(const char *name, const char phase, const double value)
+{
+    int64_t time = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - getRegistry().start).count();
+    ThreadBuffer &buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    Event &event = buffer.events[buffer.next];
+    event.name = name;
+    event.time = time;
+    event.value = value;
+    event.phase = phase;
+    if (++buffer.next == buffer.events.size())
+    {
+        buffer.next = 0;
+        buffer.isFull = true;
+    }
+}
+
+
+void writeString(std::ostream &stream, const std::string &text)
+{
+    stream << '"';
+    for (char symbol: text)
+    {
+        if ((symbol == '"') || (symbol == '\\'))
+        {
+            stream << '\\';
+        }
+        stream << symbol;
+    }
+    stream << '"';
+}
+}
+
+
+namespace trace
+{
+void setBufferSize(const size_t eventsCount)
+{
+    getRegistry().bufferSize.store(eventsCount);
+}
+
+
+void setThreadName(const std::string &name)
+{
+    ThreadBuffer &buffer = getThreadBuffer();
+    std::lock_guard<std::mutex> lock(buffer.mutex);
+    buffer.name = name;
+}
+
+
+void beginEvent(const char *name)
+{
+    record(name, 'B', 0.0);
+}
+
+
+void endEvent(const char *name)
+{
+    record(name, 'E', 0.0);
+}
+
+
+void addCounter(const char *name, const double value)
+{
+    record(name, 'C', value);
+}
+
+
+void clear()
+{
+    Registry &registry = getRegistry();
+    std::lock_guard<std::mutex> registryLock(registry.mutex);
+    for (auto &buffer: registry.buffers)
+    {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        buffer->next = 0;
+        buffer->isFull = false;
+    }
+}
+
+
+bool writeChromeTrace(std::ostream &stream)
+{
+    Registry &registry = getRegistry();
+    std::lock_guard<std::mutex> registryLock(registry.mutex);
+    stream << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+    bool isFirst = true;
+    stream << std::fixed << std::setprecision(3);
+    for (auto &buffer: registry.buffers)
+    {
+        std::lock_guard<std::mutex> lock(buffer->mutex);
+        stream << (isFirst ? "\n" : ",\n") << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": "
+               << buffer->id << ", \"args\": {\"name\": ";
+        writeString(stream, buffer->name);
+        stream << "}}";
+        isFirst = false;
+        size_t count = (buffer->isFull ? buffer->events.size() : buffer->next);
+        size_t first = (buffer->isFull ? buffer->next : 0);
+        /* The ring may have overwritten the begin of some scopes, their ends are dropped */
+        size_t depth = 0;
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Event &event = buffer->events[(first + i) % buffer->events.size()];
+            if (event.phase == 'B')
+            {
+                ++depth;
+            }
+            else if (event.phase == 'E')
+            {
+                if (depth == 0)
+                {
+                    continue;
+                }
+                --depth;
+            }
+            stream << ",\n{\"name\": ";
+            writeString(stream, event.name);
+            stream << ", \"ph\": \"" << event.phase << "\", \"ts\": " << (event.time / 1000.0)
+                   << ", \"pid\": 1, \"tid\": " << buffer->id;
+            if (event.phase == 'C')
+            {
+                stream << ", \"args\": {\"value\": " << event.value << "}";
+            }
+            stream << "}";
+        }
+    }
+    stream << "\n]}\n";
+    return stream.good();
+}
+
+
+bool isCompiled()
+{
+    return true;
+}
+}
+
+#else
+
+namespace trace
+{
+void setBufferSize(const size_t) {}
+void setThreadName(const std::string &) {}
+void beginEvent(const char *) {}
+void endEvent(const char *) {}
+void addCounter(const char *, const double) {}
+void clear() {}
+
+
+bool writeChromeTrace(std::ostream &stream)
+{
+    stream << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": []}\n";
+    return stream.good();
+}
+
+
+bool isCompiled()
+{
+    return false;
+}
+}
+
+#endif
+
+
+namespace trace
+{
+bool writeChromeTrace(const std::string &path)
+{
+    std::ofstream file(path);
+    return ((file.is_open() == true) && (writeChromeTrace(file) == true));
+}
+}
@@ -0,0 +1,70 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <ostream>
+
+
+/* Scoped timers and counters recorded into a ring buffer per thread and
+ * exported in the Chrome trace format (chrome://tracing, ui.perfetto.dev).
+ * The macros compile to nothing unless OPENTLD_TRACING is defined, the
+ * names have to be string literals. */
+namespace trace
+{
+/* Events kept per thread, older ones are overwritten. Applies to the
+ * threads recording their first event after the call. */
+void setBufferSize(const size_t eventsCount);
+void setThreadName(const std::string &name);
+void beginEvent(const char *name);
+void endEvent(const char *name);
+void addCounter(const char *name, const double value);
+void clear();
+/* Writes the events of all the threads seen so far, an empty trace
+ * when the tracing is compiled out. Returns false on a write error. */
+bool writeChromeTrace(std::ostream &stream);
+bool writeChromeTrace(const std::string &path);
+bool isCompiled();
+
+
+class Scope
+{
+public:
+    explicit Scope(const char *name)
+        : name(name)
+    {
+        beginEvent(name);
+    }
+    ~Scope()
+    {
+        endEvent(name);
+    }
+    Scope(const Scope &other) = delete;
+    Scope &operator=(const Scope &other) = delete;
+
+private:
+    const char *name;
+};
+}
+
+
+#define TLD_TRACE_CONCAT_IMPL(first, second) first##second
+#define TLD_TRACE_CONCAT(first, second) TLD_TRACE_CONCAT_IMPL(first, second)
+
+#ifdef OPENTLD_TRACING
+#define TLD_TRACE_SCOPE(name) trace::Scope TLD_TRACE_CONCAT(traceScope, __LINE__)(name)
+#define TLD_TRACE_BEGIN(name) trace::beginEvent(name)
+#define TLD_TRACE_END(name) trace::endEvent(name)
+#define TLD_TRACE_COUNTER(name, value) trace::addCounter((name), static_cast<double>(value))
+#define TLD_TRACE_THREAD_NAME(name) trace::setThreadName(name)
+#else
+#define TLD_TRACE_SCOPE(name) static_cast<void>(0)
+#define TLD_TRACE_BEGIN(name) static_cast<void>(0)
+#define TLD_TRACE_END(name) static_cast<void>(0)
+#define TLD_TRACE_COUNTER(name, value) static_cast<void>(0)
+#define TLD_TRACE_THREAD_NAME(name) static_cast<void>(0)
+#endif
+
+
+#endif /* TRACE_HPP */
@@ -1,90 +1,196 @@
 #include "Tracker.hpp"
 
 
+namespace
+{
+size_t getGreatestCommonDivisor(size_t first, size_t second)
+{
+    while (second != 0)
+    {
+        size_t remainder = first % second;
+        first = second;
+        second = remainder;
+    }
+    return first;
+}
+}
+
+
 Tracker::Tracker(std::shared_ptr<Classifier> &classifier)
-: pyramidLevel(5), classifier(classifier), templateSize(0)
+: pyramidLevel(5), classifier(classifier), templateSize(0), scaleEstimation(ScaleEstimation::Exact),
+  maxScalePairs(2048)
 {
     windowSize = cv::Size(4, 4);
     termCriteria = cv::TermCriteria(CV_TERMCRIT_EPS | CV_TERMCRIT_ITER, 20, 0.03);
 }
 
 
-void Tracker::init(const cv::Mat &frame)
+void Tracker::init(const FrameContext &context)
 {
-    prevFrame = frame.clone();
-    cv::buildOpticalFlowPyramid(prevFrame, prevFramePyr, windowSize, pyramidLevel, true);
+    prevFrame = context.getFrame();
+    prevFramePyr = context.getPyramid(windowSize, pyramidLevel);
+    prevRegion = context.getRegion();
 }
 
 
-Patch Tracker::track(const cv::Mat &frame, const cv::Rect &patchRect)
+void Tracker::prepare(const FrameContext &context) const
 {
-    nextFrame = frame.clone();
-    int minSize = std::min(patchRect.width, patchRect.height);
-    templateSize = std::min(10, (minSize / 5));
-    cv::buildOpticalFlowPyramid(nextFrame, nextFramePyr, windowSize, pyramidLevel, true);
-    std::vector<cv::Point2f> prevPoints;
-    prevPoints = getGridPoints(patchRect);
-    std::vector<cv::Point2f> nextPoints(prevPoints);
-    std::vector<cv::Point2f> testPoints(prevPoints);
-    std::vector<uchar> statusForward;
-    std::vector<uchar> statusBackward;
-    std::vector<float> errorsForward;
-    std::vector<float> errorsBackward;
-    cv::calcOpticalFlowPyrLK(prevFramePyr, nextFramePyr, prevPoints, nextPoints, statusForward, errorsForward,
-                             windowSize, pyramidLevel, termCriteria, cv::OPTFLOW_USE_INITIAL_FLOW);
-    cv::calcOpticalFlowPyrLK(nextFramePyr, prevFramePyr, nextPoints, testPoints, statusBackward, errorsBackward,
-                             windowSize, pyramidLevel, termCriteria, cv::OPTFLOW_USE_INITIAL_FLOW);
-    std::vector<uchar> status;
-    for (uint i = 0; i < statusForward.size(); ++i)
+    context.getFrame();
+    context.getPyramid(windowSize, pyramidLevel);
+}
+
+
+void Tracker::setScaleEstimation(const ScaleEstimation mode, const size_t maxPairs)
+{
+    scaleEstimation = mode;
+    maxScalePairs = std::max<size_t>(1, maxPairs);
+}
+
+
+double Tracker::getScale(const std::vector<cv::Point2f> &prevPoints, const std::vector<cv::Point2f> &nextPoints,
+                         const ScaleEstimation mode, const size_t maxPairs, std::vector<float> &ratios)
+{
+    /* The squared distances keep the order of the ratios, so the roots
+     * are taken only for the median */
+    size_t count = prevPoints.size();
+    if (count < 2)
+    {
+        return 0.0;
+    }
+    size_t pairsCount = (count * (count - 1)) / 2;
+    if ((mode == ScaleEstimation::Exact) || (pairsCount <= maxPairs))
     {
-        if ((statusForward.at(i) == 1)
-            && (statusBackward.at(i) == 1)
-            && (errorsForward.at(i) < 3.0f)
-            && (errorsBackward.at(i) < 3.0f))
+        ratios.resize(pairsCount);
+        float *ratio = ratios.data();
+        for (size_t i = 0; (i + 1) < count; ++i)
         {
-            status.push_back(1);
+            const cv::Point2f prevPoint = prevPoints[i];
+            const cv::Point2f nextPoint = nextPoints[i];
+            for (size_t j = (i + 1); j < count; ++j)
+            {
+                float prevX = prevPoint.x - prevPoints[j].x;
+                float prevY = prevPoint.y - prevPoints[j].y;
+                float nextX = nextPoint.x - nextPoints[j].x;
+                float nextY = nextPoint.y - nextPoints[j].y;
+                *(ratio++) = ((nextX * nextX) + (nextY * nextY)) / ((prevX * prevX) + (prevY * prevY));
+            }
         }
-        else
+    }
+    else
+    {
+        /* Every offset pairs each point with the one offset places further
+         * (cyclically). The offsets follow the golden ratio sequence, evenly
+         * spread offsets line up with the grid and favour the close pairs.
+         * Offsets up to (count - 1) / 2 give disjoint sets of pairs, a step
+         * coprime with their number visits each of them at most once. */
+        size_t maxOffset = std::max<size_t>(1, ((count - 1) / 2));
+        size_t offsetsCount = std::min(maxOffset, std::max<size_t>(1, (maxPairs / count)));
+        size_t offsetStep = std::max<size_t>(1, static_cast<size_t>(round(maxOffset * 0.6180339887)));
+        while (getGreatestCommonDivisor(offsetStep, maxOffset) != 1)
+        {
+            ++offsetStep;
+        }
+        ratios.resize(offsetsCount * count);
+        float *ratio = ratios.data();
+        for (size_t k = 0; k < offsetsCount; ++k)
         {
-            status.push_back(0);
+            size_t offset = 1 + (((k + 1) * offsetStep) % maxOffset);
+            for (size_t i = 0; i < count; ++i)
+            {
+                size_t j = (i + offset) % count;
+                float prevX = prevPoints[i].x - prevPoints[j].x;
+                float prevY = prevPoints[i].y - prevPoints[j].y;
+                float nextX = nextPoints[i].x - nextPoints[j].x;
+                float nextY = nextPoints[i].y - nextPoints[j].y;
+                *(ratio++) = ((nextX * nextX) + (nextY * nextY)) / ((prevX * prevX) + (prevY * prevY));
+            }
         }
     }
-    std::vector<cv::Point2f> currPrevPoints;
-    std::vector<cv::Point2f> currNextPoints;
-    std::vector<cv::Point2f> currTestPoints;
-    for (uint i = 0; i < status.size(); ++i)
+    size_t index = ratios.size() / 2;
+    std::nth_element(ratios.begin(), (ratios.begin() + index), ratios.end());
+    double scale = sqrt(ratios[index]);
+    if ((ratios.size() % 2) == 0)
+    {
+        scale = (scale + sqrt(*(std::max_element(ratios.begin(), (ratios.begin() + index))))) / 2.0;
+    }
+    return scale;
+}
+
+
+Patch Tracker::track(const FrameContext &context, const cv::Rect &patchRect)
+{
+    TLD_TRACE_SCOPE("Tracker::track");
+    /* The frames are only headers, the context products are never written */
+    const cv::Mat &frame = context.getFrame();
+    nextFrame = frame;
+    nextRegion = context.getRegion();
+    int minSize = std::min(patchRect.width, patchRect.height);
+    templateSize = std::min(10, (minSize / 5));
+    nextFramePyr = context.getPyramid(windowSize, pyramidLevel);
+    getGridPoints(patchRect, gridPoints);
+    /* The flow runs in the coordinates of the pyramids, the initial
+     * guesses keep the points in place in the frame */
+    cv::Point2f prevOrigin(prevRegion.x, prevRegion.y);
+    cv::Point2f nextOrigin(nextRegion.x, nextRegion.y);
+    flowPoints.resize(gridPoints.size());
+    trackedPoints.resize(gridPoints.size());
+    for (size_t i = 0; i < gridPoints.size(); ++i)
+    {
+        flowPoints[i] = gridPoints[i] - prevOrigin;
+        trackedPoints[i] = gridPoints[i] - nextOrigin;
+    }
+    backtrackedPoints.assign(flowPoints.begin(), flowPoints.end());
+    cv::calcOpticalFlowPyrLK(prevFramePyr, nextFramePyr, flowPoints, trackedPoints, statusForward, errorsForward,
+                             windowSize, pyramidLevel, termCriteria, cv::OPTFLOW_USE_INITIAL_FLOW);
+    cv::calcOpticalFlowPyrLK(nextFramePyr, prevFramePyr, trackedPoints, backtrackedPoints, statusBackward, errorsBackward,
+                             windowSize, pyramidLevel, termCriteria, cv::OPTFLOW_USE_INITIAL_FLOW);
+    for (size_t i = 0; i < gridPoints.size(); ++i)
+    {
+        trackedPoints[i] += nextOrigin;
+        backtrackedPoints[i] += prevOrigin;
+    }
+    currPrevPoints.clear();
+    currNextPoints.clear();
+    currTestPoints.clear();
+    for (size_t i = 0; i < statusForward.size(); ++i)
     {
-        if (status.at(i) == 1)
+        if ((statusForward[i] == 1)
+            && (statusBackward[i] == 1)
+            && (errorsForward[i] < 3.0f)
+            && (errorsBackward[i] < 3.0f))
         {
-            currPrevPoints.push_back(prevPoints.at(i));
-            currNextPoints.push_back(nextPoints.at(i));
-            currTestPoints.push_back(testPoints.at(i));
+            currPrevPoints.push_back(gridPoints[i]);
+            currNextPoints.push_back(trackedPoints[i]);
+            currTestPoints.push_back(backtrackedPoints[i]);
         }
     }
-    std::vector<double> match = getNormCrossCorrelation(currPrevPoints, currNextPoints);
-    std::vector<double> confidence = getEuclideanDistance(currPrevPoints, currTestPoints);
+    getNormCrossCorrelation(currPrevPoints, currNextPoints, match);
+    getEuclideanDistance(currPrevPoints, currTestPoints, confidence);
     double matchMedian = getMedian(match);
     double confidenceMedian = getMedian(confidence);
-    std::vector<cv::Point2f> resultPrevPoints;
-    std::vector<cv::Point2f> resultNextPoints;
-    for (uint i = 0; i < match.size(); ++i)
+    resultPrevPoints.clear();
+    resultNextPoints.clear();
+    for (size_t i = 0; i < match.size(); ++i)
     {
-        if ((match.at(i) >= matchMedian) && (confidence.at(i) <= confidenceMedian))
+        if ((match[i] >= matchMedian) && (confidence[i] <= confidenceMedian))
         {
-            resultPrevPoints.push_back(currPrevPoints.at(i));
-            resultNextPoints.push_back(currNextPoints.at(i));
+            resultPrevPoints.push_back(currPrevPoints[i]);
+            resultNextPoints.push_back(currNextPoints[i]);
         }
     }
-    prevFrame = frame.clone();
+    prevFrame = frame;
     prevFramePyr.swap(nextFramePyr);
+    prevRegion = nextRegion;
     Patch trackedPatch;
     if (resultPrevPoints.size() > 0)
     {
         trackedPatch.rect = getBoundedRect(patchRect, resultPrevPoints, resultNextPoints);
     }
-    cv::Mat integralFrame;
-    cv::integral(frame, integralFrame);
-    trackedPatch.confidence = classifier->classify(integralFrame, trackedPatch.rect);
+    /* The integral frame holds nothing outside the region */
+    if ((trackedPatch.rect & nextRegion) == trackedPatch.rect)
+    {
+        trackedPatch.confidence = classifier->classify(context, trackedPatch.rect);
+    }
     if (((trackedPatch.rect.tl().x >= 0)
         && (trackedPatch.rect.tl().y >= 0)
         && (trackedPatch.rect.br().x < frame.cols)
@@ -96,73 +202,67 @@ Patch Tracker::track(const cv::Mat &frame, const cv::Rect &patchRect)
 }
 
 
-double Tracker::getMedian(const std::vector<double> &array) const
+double Tracker::getMedian(const std::vector<double> &array)
 {
-    double median;
-    std::vector<double> tmp(array);
-    if(tmp.size() == 0)
-    {
-        median = 0.0;
-    }
-    else if (tmp.size() == 1)
+    /* Selection on a reused copy, the caller still needs the order */
+    double median = 0.0;
+    if (array.empty() == false)
     {
-        median = tmp.at(0);
-    }
-    else if (tmp.size() == 2)
-    {
-        median = ((tmp.at(0) + tmp.at(1)) / 2.0);
-    }
-    else
-    {
-        int index = (tmp.size() / 2);
-        std::sort(tmp.begin(), tmp.end());
-        if ((tmp.size() % 2) == 0)
-        {
-            median = ((tmp.at(index) + tmp.at(index - 1)) / 2.0);
-        }
-        else
+        medianBuffer.assign(array.begin(), array.end());
+        size_t index = medianBuffer.size() / 2;
+        std::nth_element(medianBuffer.begin(), (medianBuffer.begin() + index), medianBuffer.end());
+        median = medianBuffer[index];
+        if ((medianBuffer.size() % 2) == 0)
         {
-            median = tmp.at(index);
+            median = (median + *(std::max_element(medianBuffer.begin(), (medianBuffer.begin() + index)))) / 2.0;
         }
     }
     return median;
 }
 
 
-std::vector<double> Tracker::getEuclideanDistance(const std::vector<cv::Point2f> &forwardPoints,
-                                                  const std::vector<cv::Point2f> &backwardPoints) const
+void Tracker::getEuclideanDistance(const std::vector<cv::Point2f> &forwardPoints,
+                                   const std::vector<cv::Point2f> &backwardPoints,
+                                   std::vector<double> &distances) const
 {
-    std::vector<double> confidence;
-    for (uint i = 0; i < forwardPoints.size(); ++i)
+    distances.resize(forwardPoints.size());
+    for (size_t i = 0; i < forwardPoints.size(); ++i)
     {
-        double diffX = pow((forwardPoints.at(i).x - backwardPoints.at(i).x), 2);
-        double diffY = pow((forwardPoints.at(i).y - backwardPoints.at(i).y), 2);
-        double fbError = sqrt(diffX + diffY);
-        confidence.push_back(fbError);
+        double diffX = forwardPoints[i].x - backwardPoints[i].x;
+        double diffY = forwardPoints[i].y - backwardPoints[i].y;
+        distances[i] = sqrt((diffX * diffX) + (diffY * diffY));
     }
-    return confidence;
 }
 
 
-std::vector<double> Tracker::getNormCrossCorrelation(const std::vector<cv::Point2f> &prevPoints,
-                                                     const std::vector<cv::Point2f> &nextPoints) const
+void Tracker::getNormCrossCorrelation(const std::vector<cv::Point2f> &prevPoints,
+                                      const std::vector<cv::Point2f> &nextPoints,
+                                      std::vector<double> &correlations)
 {
-    cv::Mat prevPatch;
-    cv::Mat nextPatch;
-    cv::Mat result;
-    std::vector<double> match;
-    for (uint i = 0; i < nextPoints.size(); ++i)
-    {
-        cv::getRectSubPix(prevFrame, cv::Size(templateSize, templateSize), prevPoints[i], prevPatch);
-        cv::getRectSubPix(nextFrame, cv::Size(templateSize, templateSize), nextPoints[i], nextPatch);
-        cv::matchTemplate(prevPatch, nextPatch, result, cv::TM_CCOEFF);
-        match.push_back(result.at<float>(0, 0));
-    }
-    return match;
+    correlations.assign(nextPoints.size(), 0.0);
+    /* The patches are sampled from the part both frames hold,
+     * its borders are replicated like the frame borders */
+    cv::Rect region = prevRegion & nextRegion;
+    if ((nextPoints.empty() == false) && (region.area() > 0))
+    {
+        cv::Point2f origin(region.x, region.y);
+        correlationPrevPoints.resize(prevPoints.size());
+        correlationNextPoints.resize(nextPoints.size());
+        for (size_t i = 0; i < nextPoints.size(); ++i)
+        {
+            correlationPrevPoints[i] = prevPoints[i] - origin;
+            correlationNextPoints[i] = nextPoints[i] - origin;
+        }
+        kernels::getCrossCorrelations(prevFrame.ptr<uint8_t>(region.y, region.x), nextFrame.ptr<uint8_t>(region.y, region.x),
+                                      prevFrame.step1(), nextFrame.step1(), region.width, region.height,
+                                      reinterpret_cast<const float *>(correlationPrevPoints.data()),
+                                      reinterpret_cast<const float *>(correlationNextPoints.data()), nextPoints.size(),
+                                      templateSize, correlations.data());
+    }
 }
 
 
-std::vector<cv::Point2f> Tracker::getGridPoints(const cv::Rect &rect) const
+void Tracker::getGridPoints(const cv::Rect &rect, std::vector<cv::Point2f> &points) const
 {
     cv::Rect localRect;
     localRect.x = rect.x + (templateSize / 2);
@@ -172,43 +272,32 @@ std::vector<cv::Point2f> Tracker::getGridPoints(const cv::Rect &rect) const
     int gridPointsCount = std::min(20, std::min((localRect.width), (localRect.height)));
     double stepByWidth = static_cast<double>(localRect.width) / (gridPointsCount - 1);
     double stepByHeight = static_cast<double>(localRect.height) / (gridPointsCount - 1);
-    std::vector<cv::Point2f> gridPoints;
+    points.clear();
     for (int i = 0; i < gridPointsCount; ++i)
     {
         for (int j = 0; j < gridPointsCount; ++j)
         {
             double x = localRect.x + (stepByWidth * i);
             double y = localRect.y + (stepByHeight * j);
-            gridPoints.push_back(cv::Point2f(x, y));
+            points.push_back(cv::Point2f(x, y));
         }
     }
-    return gridPoints;
 }
 
 
 cv::Rect Tracker::getBoundedRect(const cv::Rect &rect, const std::vector<cv::Point2f> &prevPoints,
-                                 const std::vector<cv::Point2f> &nextPoints) const
+                                 const std::vector<cv::Point2f> &nextPoints)
 {
-    std::vector<double> diffX;
-    std::vector<double> diffY;
-    for (uint point = 0; point < prevPoints.size(); ++point)
+    shiftsX.resize(prevPoints.size());
+    shiftsY.resize(prevPoints.size());
+    for (size_t point = 0; point < prevPoints.size(); ++point)
     {
-        diffX.push_back(nextPoints.at(point).x - prevPoints.at(point).x);
-        diffY.push_back(nextPoints.at(point).y - prevPoints.at(point).y);
-    }
-    double dX = getMedian(diffX);
-    double dY = getMedian(diffY);
-    std::vector<double> pointsShift;
-    for (uint i = 0; i < (prevPoints.size() - 1); ++i)
-    {
-        for (uint j = (i + 1); j < prevPoints.size(); ++j)
-        {
-            double distPrev = sqrt(pow((prevPoints.at(i).x - prevPoints.at(j).x), 2) + pow((prevPoints.at(i).y - prevPoints.at(j).y), 2));
-            double distNext = sqrt(pow((nextPoints.at(i).x - nextPoints.at(j).x), 2) + pow((nextPoints.at(i).y - nextPoints.at(j).y), 2));
-            pointsShift.push_back(distNext / distPrev);
-        }
+        shiftsX[point] = nextPoints[point].x - prevPoints[point].x;
+        shiftsY[point] = nextPoints[point].y - prevPoints[point].y;
     }
-    double shift = getMedian(pointsShift);
+    double dX = getMedian(shiftsX);
+    double dY = getMedian(shiftsY);
+    double shift = getScale(prevPoints, nextPoints, scaleEstimation, maxScalePairs, scaleRatios);
     double shiftW = 0.5 * (shift - 1) * rect.width;
     double shiftH = 0.5 * (shift - 1) * rect.height;
     cv::Rect boundedRect;
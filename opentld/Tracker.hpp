@@ -4,12 +4,26 @@
 #include <vector>
 #include <memory>
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 
 #include <opencv2/imgproc/imgproc.hpp>
 #include <opencv2/video/tracking.hpp>
 
 #include "Classifier.hpp"
 #include "Patch.hpp"
+#include "FrameContext.hpp"
+
+
+/* How the median flow scale change is estimated from the point pairs */
+enum class ScaleEstimation
+{
+    /* Median over all the pairs of the tracked points */
+    Exact,
+    /* Median over at most maxPairs distinct pairs taken at fixed index
+     * offsets, every point is in the same number of pairs */
+    Subsampled
+};
 
 
 class Tracker
@@ -17,28 +31,63 @@ class Tracker
 public:
     explicit Tracker(std::shared_ptr<Classifier> &classifier);
     ~Tracker() = default;
-    void init(const cv::Mat &frame);
-    Patch track(const cv::Mat &frame, const cv::Rect &patchRect);
+    void init(const FrameContext &context);
+    /* Computes the frame products track() needs, may run concurrently with track() */
+    void prepare(const FrameContext &context) const;
+    /* Exact by default, Subsampled bounds the cost for the dense point grids */
+    void setScaleEstimation(const ScaleEstimation mode, const size_t maxPairs = 2048);
+    /* Median ratio of the pairwise distances of nextPoints to the ones of prevPoints,
+     * ratios is a working buffer */
+    static double getScale(const std::vector<cv::Point2f> &prevPoints, const std::vector<cv::Point2f> &nextPoints,
+                           const ScaleEstimation mode, const size_t maxPairs, std::vector<float> &ratios);
+    Patch track(const FrameContext &context, const cv::Rect &patchRect);
 
 private:
     const int pyramidLevel;
     cv::Mat prevFrame;
     cv::Mat nextFrame;
+    /* Context regions of the frames, the pyramids are in their coordinates */
+    cv::Rect prevRegion;
+    cv::Rect nextRegion;
     std::vector<cv::Mat> prevFramePyr;
     std::vector<cv::Mat> nextFramePyr;
     cv::Size windowSize;
     cv::TermCriteria termCriteria;
     std::shared_ptr<Classifier> classifier;
     int templateSize;
+    ScaleEstimation scaleEstimation;
+    size_t maxScalePairs;
+    /* Working buffers kept across the frames to avoid the allocations */
+    std::vector<cv::Point2f> gridPoints;
+    std::vector<cv::Point2f> flowPoints;
+    std::vector<cv::Point2f> trackedPoints;
+    std::vector<cv::Point2f> backtrackedPoints;
+    std::vector<uchar> statusForward;
+    std::vector<uchar> statusBackward;
+    std::vector<float> errorsForward;
+    std::vector<float> errorsBackward;
+    std::vector<cv::Point2f> currPrevPoints;
+    std::vector<cv::Point2f> currNextPoints;
+    std::vector<cv::Point2f> currTestPoints;
+    std::vector<cv::Point2f> resultPrevPoints;
+    std::vector<cv::Point2f> resultNextPoints;
+    std::vector<double> match;
+    std::vector<double> confidence;
+    std::vector<double> shiftsX;
+    std::vector<double> shiftsY;
+    std::vector<float> scaleRatios;
+    std::vector<double> medianBuffer;
+    std::vector<cv::Point2f> correlationPrevPoints;
+    std::vector<cv::Point2f> correlationNextPoints;
 
-    double getMedian(const std::vector<double> &array) const;
-    std::vector<double> getEuclideanDistance(const std::vector<cv::Point2f> &forwardPoints,
-                                            const std::vector<cv::Point2f> &backwardPoints) const;
-    std::vector<double> getNormCrossCorrelation(const std::vector<cv::Point2f> &prevPoints,
-                                               const std::vector<cv::Point2f> &nextPoints) const;
-    std::vector<cv::Point2f> getGridPoints(const cv::Rect &rect) const;
+    double getMedian(const std::vector<double> &array);
+    void getEuclideanDistance(const std::vector<cv::Point2f> &forwardPoints,
+                              const std::vector<cv::Point2f> &backwardPoints, std::vector<double> &distances) const;
+    void getNormCrossCorrelation(const std::vector<cv::Point2f> &prevPoints,
+                                 const std::vector<cv::Point2f> &nextPoints, std::vector<double> &correlations);
+    void getGridPoints(const cv::Rect &rect, std::vector<cv::Point2f> &points) const;
     cv::Rect getBoundedRect(const cv::Rect &rect, const std::vector<cv::Point2f> &prevPoints,
-                            const std::vector<cv::Point2f> &nextPoints) const;
+                            const std::vector<cv::Point2f> &nextPoints);
 };
 
 #endif /* TRACKER_HPP */
@@ -0,0 +1,266 @@
+#include "TrackingService.hpp"
+
+#include <algorithm>
+#include <string>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+
+TrackingService::TrackingService(const size_t workersCount, const size_t queueCapacity, const bool isAffinityEnabled)
+: serialPool(std::make_shared<ThreadPool>(0)), queueCapacity(queueCapacity), nextStreamId(0), lastStreamId(-1),
+  busyCount(0), isStopping(false)
+{
+    for (size_t index = 0; index < std::max<size_t>(1, workersCount); ++index)
+    {
+        workers.push_back(std::thread(&TrackingService::run, this, index, isAffinityEnabled));
+    }
+}
+
+
+TrackingService::~TrackingService()
+{
+    stop();
+}
+
+
+int TrackingService::addStream(const cv::Rect &targetRect, ResultCallback callback,
+                               const int ferns, const int nodes, const double minFeatureScale, const double maxFeatureScale)
+{
+    std::shared_ptr<Stream> stream = std::make_shared<Stream>(queueCapacity);
+    stream->tracker = std::make_shared<TLDTracker>(ferns, nodes, minFeatureScale, maxFeatureScale, serialPool);
+    stream->callback = callback;
+    stream->targetRect = targetRect;
+    std::lock_guard<std::mutex> lock(mutex);
+    stream->id = nextStreamId++;
+    streams[stream->id] = stream;
+    return stream->id;
+}
+
+
+bool TrackingService::removeStream(const int streamId)
+{
+    std::shared_ptr<Stream> stream;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iterator = streams.find(streamId);
+        if (iterator == streams.end())
+        {
+            return false;
+        }
+        stream = iterator->second;
+        streams.erase(iterator);
+        stream->queue.close();
+        stream->queue.clear();
+    }
+    idleCondition.notify_all();
+    return true;
+}
+
+
+bool TrackingService::pushFrame(const int streamId, const cv::Mat &frameRGB, const bool isWaiting)
+{
+    std::shared_ptr<Stream> stream;
+    QueuedFrame queuedFrame;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto iterator = streams.find(streamId);
+        if ((isStopping == true) || (iterator == streams.end()))
+        {
+            return false;
+        }
+        stream = iterator->second;
+        queuedFrame.index = stream->pushedFrames++;
+    }
+    queuedFrame.frame = frameRGB;
+    queuedFrame.pushTime = std::chrono::steady_clock::now();
+    bool isQueued = true;
+    size_t droppedCount = 0;
+    if (isWaiting == true)
+    {
+        isQueued = stream->queue.push(std::move(queuedFrame));
+        droppedCount = ((isQueued == true) ? 0 : 1);
+    }
+    else
+    {
+        droppedCount = stream->queue.pushDroppingOldest(std::move(queuedFrame));
+    }
+    {
+        /* The queue has its own lock: taking the service one after the push
+         * orders it with the workers checking hasWork() before they wait,
+         * so none of them can miss the notification */
+        std::lock_guard<std::mutex> lock(mutex);
+        stream->statistics.droppedFrames += droppedCount;
+    }
+    workCondition.notify_one();
+    return isQueued;
+}
+
+
+void TrackingService::waitIdle()
+{
+    std::unique_lock<std::mutex> lock(mutex);
+    idleCondition.wait(lock, [this] { return ((isStopping == true) || ((busyCount == 0) && (hasWork() == false))); });
+}
+
+
+void TrackingService::stop()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (isStopping == true)
+        {
+            return;
+        }
+        isStopping = true;
+        for (auto &item: streams)
+        {
+            item.second->queue.close();
+        }
+    }
+    workCondition.notify_all();
+    idleCondition.notify_all();
+    for (auto &worker: workers)
+    {
+        worker.join();
+    }
+}
+
+
+std::vector<int> TrackingService::getStreamIds() const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    std::vector<int> ids;
+    for (const auto &item: streams)
+    {
+        ids.push_back(item.first);
+    }
+    return ids;
+}
+
+
+bool TrackingService::getStatistics(const int streamId, StreamStatistics &statistics) const
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    auto iterator = streams.find(streamId);
+    if (iterator == streams.end())
+    {
+        return false;
+    }
+    const Stream &stream = *(iterator->second);
+    statistics = stream.statistics;
+    statistics.backlog = stream.queue.size() + ((stream.isBusy == true) ? 1 : 0);
+    return true;
+}
+
+
+size_t TrackingService::getWorkersCount() const
+{
+    return workers.size();
+}
+
+
+void TrackingService::run(const size_t index, const bool isAffinityEnabled)
+{
+    TLD_TRACE_THREAD_NAME("service worker " + std::to_string(index));
+#ifdef __linux__
+    if (isAffinityEnabled == true)
+    {
+        size_t cpusCount = std::max<size_t>(1, std::thread::hardware_concurrency());
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET((index % cpusCount), &cpus);
+        pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus);
+    }
+#else
+    static_cast<void>(isAffinityEnabled);
+#endif
+    std::unique_lock<std::mutex> lock(mutex);
+    while (true)
+    {
+        workCondition.wait(lock, [this] { return ((isStopping == true) || (hasWork() == true)); });
+        if (isStopping == true)
+        {
+            break;
+        }
+        QueuedFrame queuedFrame;
+        std::shared_ptr<Stream> stream = getNextStream(queuedFrame);
+        if (stream == nullptr)
+        {
+            continue;
+        }
+        lock.unlock();
+        process(*stream, queuedFrame);
+        lock.lock();
+        stream->isBusy = false;
+        --busyCount;
+        /* The stream may have more frames for the other workers */
+        workCondition.notify_one();
+        idleCondition.notify_all();
+    }
+}
+
+
+std::shared_ptr<TrackingService::Stream> TrackingService::getNextStream(QueuedFrame &queuedFrame)
+{
+    /* Round robin over the ids starting after the last served stream */
+    auto start = streams.upper_bound(lastStreamId);
+    for (size_t i = 0; i < streams.size(); ++i, ++start)
+    {
+        if (start == streams.end())
+        {
+            start = streams.begin();
+        }
+        Stream &stream = *(start->second);
+        if ((stream.isBusy == false) && (stream.queue.tryPop(queuedFrame) == true))
+        {
+            stream.isBusy = true;
+            ++busyCount;
+            lastStreamId = start->first;
+            return start->second;
+        }
+    }
+    return nullptr;
+}
+
+
+bool TrackingService::hasWork() const
+{
+    for (const auto &item: streams)
+    {
+        if ((item.second->isBusy == false) && (item.second->queue.empty() == false))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void TrackingService::process(Stream &stream, QueuedFrame &queuedFrame)
+{
+    TLD_TRACE_SCOPE("TrackingService::process");
+    /* Only the worker holding the busy stream touches its tracker and target */
+    /* The frames are timed at the push, the queueing does not skew the motion */
+    double timestamp = std::chrono::duration<double>(queuedFrame.pushTime.time_since_epoch()).count();
+    stream.targetRect = stream.tracker->getTargetRect(queuedFrame.frame, stream.targetRect, FrameFormat::Rgb, timestamp);
+    const TLDStatistics &trackerStatistics = stream.tracker->getStatistics();
+    double latency = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - queuedFrame.pushTime).count();
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        StreamStatistics &statistics = stream.statistics;
+        ++statistics.processedFrames;
+        stream.latencySum += latency;
+        statistics.lastLatency = latency;
+        statistics.meanLatency = stream.latencySum / statistics.processedFrames;
+        statistics.maxLatency = std::max(statistics.maxLatency, latency);
+        statistics.lastConfidence = trackerStatistics.confidence;
+        statistics.lastRect = stream.targetRect;
+    }
+    if (stream.callback != nullptr)
+    {
+        stream.callback(stream.id, queuedFrame.index, stream.targetRect, trackerStatistics);
+    }
+}
@@ -0,0 +1,116 @@
+#ifndef TRACKINGSERVICE_HPP
+#define TRACKINGSERVICE_HPP
+
+#include <vector>
+#include <map>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "ThreadPool.hpp"
+#include "BoundedQueue.hpp"
+#include "TLDTracker.hpp"
+#include "Trace.hpp"
+
+
+/* Per-stream counters, the latencies are measured from pushFrame()
+ * to the end of the processing in milliseconds */
+struct StreamStatistics
+{
+    StreamStatistics()
+        : backlog(0), processedFrames(0), droppedFrames(0), lastLatency(0.0), meanLatency(0.0), maxLatency(0.0),
+          lastConfidence(0.0), lastRect(0, 0, 0, 0) {}
+    size_t backlog;
+    size_t processedFrames;
+    size_t droppedFrames;
+    double lastLatency;
+    double meanLatency;
+    double maxLatency;
+    double lastConfidence;
+    cv::Rect lastRect;
+};
+
+
+/* Many independent TLDTracker sessions in one process. Frames of every
+ * stream go to a bounded queue, a fixed set of workers takes them round
+ * robin over the streams, one frame of a stream at a time so the frames
+ * of a stream are processed in order. The sessions run their stages
+ * serially, the parallelism comes from the streams. */
+class TrackingService
+{
+public:
+    using ResultCallback = std::function<void(const int streamId, const size_t frameIndex, const cv::Rect &rect,
+                                              const TLDStatistics &statistics)>;
+
+    /* isAffinityEnabled pins the workers to the CPUs one by one (Linux only) */
+    explicit TrackingService(const size_t workersCount = (ThreadPool::getDefaultThreadsCount() + 1),
+                             const size_t queueCapacity = 4, const bool isAffinityEnabled = false);
+    ~TrackingService();
+    TrackingService(const TrackingService &other) = delete;
+    TrackingService &operator=(const TrackingService &other) = delete;
+    /* The target is learned on the first frame of the stream, returns the stream id */
+    int addStream(const cv::Rect &targetRect, ResultCallback callback = nullptr,
+                  const int ferns = 12, const int nodes = 6, const double minFeatureScale = 0.2, const double maxFeatureScale = 0.5);
+    /* Drops the queued frames, a frame in progress still completes */
+    bool removeStream(const int streamId);
+    /* The service keeps a reference to the frame data, so the caller must not
+     * write into it afterwards (read every frame into a new cv::Mat). A full
+     * queue drops its oldest frame (counted in droppedFrames) or, with
+     * isWaiting, blocks the caller. Returns false when the frame was not
+     * queued: unknown stream or the service is stopping. */
+    bool pushFrame(const int streamId, const cv::Mat &frameRGB, const bool isWaiting = false);
+    /* Blocks until the queues are empty and no frame is in progress */
+    void waitIdle();
+    void stop();
+    std::vector<int> getStreamIds() const;
+    /* Returns false and leaves statistics unchanged for an unknown stream */
+    bool getStatistics(const int streamId, StreamStatistics &statistics) const;
+    size_t getWorkersCount() const;
+
+private:
+    struct QueuedFrame
+    {
+        cv::Mat frame;
+        size_t index;
+        std::chrono::steady_clock::time_point pushTime;
+    };
+
+    struct Stream
+    {
+        explicit Stream(const size_t queueCapacity)
+            : id(0), queue(queueCapacity), isBusy(false), pushedFrames(0), latencySum(0.0) {}
+        int id;
+        BoundedQueue<QueuedFrame> queue;
+        std::shared_ptr<TLDTracker> tracker;
+        ResultCallback callback;
+        cv::Rect targetRect;
+        bool isBusy;
+        size_t pushedFrames;
+        double latencySum;
+        StreamStatistics statistics;
+    };
+
+    std::shared_ptr<ThreadPool> serialPool;
+    std::vector<std::thread> workers;
+    size_t queueCapacity;
+    mutable std::mutex mutex;
+    std::condition_variable workCondition;
+    std::condition_variable idleCondition;
+    std::map<int, std::shared_ptr<Stream>> streams;
+    int nextStreamId;
+    int lastStreamId;
+    size_t busyCount;
+    bool isStopping;
+
+    void run(const size_t index, const bool isAffinityEnabled);
+    std::shared_ptr<Stream> getNextStream(QueuedFrame &queuedFrame);
+    bool hasWork() const;
+    void process(Stream &stream, QueuedFrame &queuedFrame);
+};
+
+#endif /* TRACKINGSERVICE_HPP */
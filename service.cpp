@@ -0,0 +1,214 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <cstdlib>
+#include <cmath>
+
+#include <opencv2/videoio.hpp>
+
+#include "opentld/TrackingService.hpp"
+
+
+/* Many streams tracked in one process by TrackingService. Every source is a
+ * video file or an image sequence read by its own thread, optionally paced
+ * to a frame rate and replayed in a loop to emulate a live camera. */
+
+
+struct Source
+{
+    std::string path;
+    cv::Rect rect;
+    int streamId;
+};
+
+
+void printUsage(const char *name)
+{
+    std::cerr << "Usage: " << name << " --stream <video | image pattern> x,y,w,h [--stream ...]\n"
+              << "       [--workers count] [--queue capacity] [--affinity] [--fps rate] [--loop]\n"
+              << "       [--duration seconds] [--report seconds]" << std::endl;
+}
+
+
+bool parseRect(const std::string &text, cv::Rect &rect)
+{
+    std::string values(text);
+    std::replace(values.begin(), values.end(), ',', ' ');
+    std::istringstream stream(values);
+    double x, y, width, height;
+    if (((stream >> x >> y >> width >> height).fail() == true) || (width <= 0.0) || (height <= 0.0))
+    {
+        return false;
+    }
+    rect = cv::Rect(static_cast<int>(round(x)), static_cast<int>(round(y)),
+                    static_cast<int>(round(width)), static_cast<int>(round(height)));
+    return true;
+}
+
+
+void printStatistics(TrackingService &service, const std::vector<Source> &sources)
+{
+    for (const auto &source: sources)
+    {
+        StreamStatistics statistics;
+        service.getStatistics(source.streamId, statistics);
+        std::cout << "stream " << source.streamId << " (" << source.path << "): processed " << statistics.processedFrames
+                  << ", dropped " << statistics.droppedFrames << ", backlog " << statistics.backlog
+                  << ", latency last/mean/max (ms) " << statistics.lastLatency << "/" << statistics.meanLatency
+                  << "/" << statistics.maxLatency << ", confidence " << statistics.lastConfidence << "\n";
+    }
+    std::cout << std::flush;
+}
+
+
+int main(int argc, char* argv[])
+{
+    std::vector<Source> sources;
+    size_t workersCount = ThreadPool::getDefaultThreadsCount() + 1;
+    size_t queueCapacity = 4;
+    bool isAffinityEnabled = false;
+    bool isLooping = false;
+    double frameRate = 0.0;
+    double duration = 0.0;
+    double reportPeriod = 1.0;
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string argument(argv[i]);
+        bool hasValue = ((i + 1) < argc);
+        if ((argument == "--stream") && ((i + 2) < argc))
+        {
+            Source source;
+            source.path = argv[++i];
+            source.streamId = -1;
+            if (parseRect(argv[++i], source.rect) == false)
+            {
+                printUsage(argv[0]);
+                return 1;
+            }
+            sources.push_back(source);
+        }
+        else if ((argument == "--workers") && (hasValue == true))
+        {
+            workersCount = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if ((argument == "--queue") && (hasValue == true))
+        {
+            queueCapacity = static_cast<size_t>(std::max(1, std::atoi(argv[++i])));
+        }
+        else if ((argument == "--fps") && (hasValue == true))
+        {
+            frameRate = std::atof(argv[++i]);
+        }
+        else if ((argument == "--duration") && (hasValue == true))
+        {
+            duration = std::atof(argv[++i]);
+        }
+        else if ((argument == "--report") && (hasValue == true))
+        {
+            reportPeriod = std::max(0.1, std::atof(argv[++i]));
+        }
+        else if (argument == "--affinity")
+        {
+            isAffinityEnabled = true;
+        }
+        else if (argument == "--loop")
+        {
+            isLooping = true;
+        }
+        else
+        {
+            printUsage(argv[0]);
+            return 1;
+        }
+    }
+    if (sources.empty() == true)
+    {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    TrackingService service(workersCount, queueCapacity, isAffinityEnabled);
+    for (auto &source: sources)
+    {
+        source.streamId = service.addStream(source.rect);
+    }
+
+    /* Paced sources behave like cameras and drop frames when the service
+     * falls behind, unpaced ones wait for a free place in the queue */
+    std::atomic<bool> isStopping(false);
+    std::atomic<size_t> activeReaders(sources.size());
+    std::vector<std::thread> readers;
+    for (const auto &source: sources)
+    {
+        readers.push_back(std::thread([&service, &isStopping, &activeReaders, source, frameRate, isLooping]()
+        {
+            cv::VideoCapture capture;
+            if (capture.open(source.path) == false)
+            {
+                std::cerr << "Cannot open " << source.path << std::endl;
+            }
+            auto period = std::chrono::duration<double>((frameRate > 0.0) ? (1.0 / frameRate) : 0.0);
+            auto nextTime = std::chrono::steady_clock::now();
+            while ((capture.isOpened() == true) && (isStopping.load() == false))
+            {
+                cv::Mat frame;
+                if (capture.read(frame) == false)
+                {
+                    if ((isLooping == false) || (capture.open(source.path) == false) || (capture.read(frame) == false))
+                    {
+                        break;
+                    }
+                }
+                service.pushFrame(source.streamId, frame, (frameRate <= 0.0));
+                if (frameRate > 0.0)
+                {
+                    nextTime += std::chrono::duration_cast<std::chrono::steady_clock::duration>(period);
+                    std::this_thread::sleep_until(nextTime);
+                }
+            }
+            --activeReaders;
+        }));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    auto nextReport = start;
+    while (activeReaders.load() > 0)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        auto now = std::chrono::steady_clock::now();
+        if ((duration > 0.0) && (std::chrono::duration<double>(now - start).count() >= duration))
+        {
+            isStopping = true;
+        }
+        if (now >= nextReport)
+        {
+            printStatistics(service, sources);
+            nextReport = now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                std::chrono::duration<double>(reportPeriod));
+        }
+    }
+    for (auto &reader: readers)
+    {
+        reader.join();
+    }
+    service.waitIdle();
+    double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    printStatistics(service, sources);
+    size_t processedFrames = 0;
+    for (const auto &source: sources)
+    {
+        StreamStatistics statistics;
+        service.getStatistics(source.streamId, statistics);
+        processedFrames += statistics.processedFrames;
+    }
+    std::cout << "total: " << processedFrames << " frames in " << elapsed << " s, "
+              << ((elapsed > 0.0) ? (processedFrames / elapsed) : 0.0) << " FPS over "
+              << sources.size() << " streams on " << service.getWorkersCount() << " workers" << std::endl;
+    service.stop();
+    return 0;
+}
@@ -0,0 +1,57 @@
+#include <iostream>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "opentld/FrameContext.hpp"
+
+
+/* The luma formats take the frame as the gray one, other types are rejected */
+
+
+bool check(const bool condition, const char *message)
+{
+    if (condition == false)
+    {
+        std::cerr << "FAILED: " << message << std::endl;
+    }
+    return condition;
+}
+
+
+bool isRejected(const cv::Mat &frame, const FrameFormat format)
+{
+    try
+    {
+        FrameContext context(frame, format);
+    }
+    catch (const cv::Exception &)
+    {
+        return true;
+    }
+    return false;
+}
+
+
+int main()
+{
+    cv::Mat colorFrame(48, 64, CV_8UC3, cv::Scalar(10, 120, 250));
+    cv::Mat lumaFrame;
+    cv::cvtColor(colorFrame, lumaFrame, cv::COLOR_RGB2GRAY);
+
+    bool isPassed = true;
+    isPassed &= check((isRejected(colorFrame, FrameFormat::Luma) == true), "a color frame is rejected as Luma");
+    isPassed &= check((isRejected(colorFrame, FrameFormat::BlurredLuma) == true),
+                      "a color frame is rejected as BlurredLuma");
+    isPassed &= check((isRejected(cv::Mat(48, 64, CV_16UC1, cv::Scalar(0)), FrameFormat::Luma) == true),
+                      "a 16-bit frame is rejected as Luma");
+    isPassed &= check((isRejected(colorFrame, FrameFormat::Rgb) == false), "a color frame is accepted as Rgb");
+    isPassed &= check((isRejected(lumaFrame, FrameFormat::Rgb) == false), "a gray frame is accepted as Rgb");
+
+    /* The same picture as luma gives the same products as in color */
+    FrameContext colorContext(colorFrame, FrameFormat::Rgb);
+    FrameContext lumaContext(lumaFrame, FrameFormat::Luma);
+    isPassed &= check((lumaContext.getGray().type() == CV_8UC1), "the luma frame is the gray frame");
+    isPassed &= check((cv::norm(colorContext.getIntegral(), lumaContext.getIntegral(), cv::NORM_INF) == 0.0),
+                      "a luma frame gives the integral of its color frame");
+    return ((isPassed == true) ? 0 : 1);
+}
@@ -0,0 +1,64 @@
+#include <iostream>
+#include <vector>
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include "opentld/TLDTracker.hpp"
+
+
+/* A snapshot rejected by loadSnapshot() must leave the tracker as it was */
+
+
+cv::Mat getSyntheticFrame(const cv::Size &size, const unsigned int seed)
+{
+    cv::RNG rng(seed);
+    cv::Mat noise(size, CV_8UC3);
+    rng.fill(noise, cv::RNG::UNIFORM, cv::Scalar(0, 0, 0), cv::Scalar(256, 256, 256));
+    cv::Mat frame;
+    cv::GaussianBlur(noise, frame, cv::Size(0, 0), 2.0);
+    return frame;
+}
+
+
+bool check(const bool condition, const char *message)
+{
+    if (condition == false)
+    {
+        std::cerr << "FAILED: " << message << std::endl;
+    }
+    return condition;
+}
+
+
+int main()
+{
+    const cv::Size frameSize(320, 240);
+    std::shared_ptr<ThreadPool> pool = std::make_shared<ThreadPool>(2);
+
+    Feature::setSeed(1);
+    TLDTracker saved(12, 6, 0.2, 0.5, pool);
+    saved.getTargetRect(getSyntheticFrame(frameSize, 1), cv::Rect(100, 80, 64, 48), FrameFormat::Rgb, 0.0);
+    std::vector<char> bytes = saved.getSnapshot();
+
+    Feature::setSeed(2);
+    TLDTracker tracker(12, 6, 0.2, 0.5, pool);
+    tracker.getTargetRect(getSyntheticFrame(frameSize, 2), cv::Rect(40, 30, 48, 64), FrameFormat::Rgb, 0.0);
+    const std::vector<char> before = tracker.getSnapshot();
+
+    bool isPassed = true;
+    isPassed &= check((tracker.loadSnapshot(bytes.data(), bytes.size()) == true), "a whole snapshot loads");
+    isPassed &= check((tracker.getSnapshot() == bytes), "a loaded snapshot restores the saved state");
+
+    /* The detector section is the last one, so dropping the last byte truncates
+     * it after the whole classifier section has been read */
+    bool isRestored = tracker.loadSnapshot(before.data(), before.size());
+    isPassed &= check((isRestored == true), "the previous snapshot loads back");
+    isPassed &= check((tracker.loadSnapshot(bytes.data(), (bytes.size() - 1)) == false),
+                      "a snapshot truncated in the detector section is rejected");
+    isPassed &= check((tracker.getSnapshot() == before), "a rejected snapshot keeps the previous state");
+
+    isPassed &= check((tracker.loadSnapshot(bytes.data(), (bytes.size() / 2)) == false),
+                      "a snapshot truncated in the classifier tables is rejected");
+    isPassed &= check((tracker.getSnapshot() == before), "a rejected snapshot keeps the previous state");
+    return ((isPassed == true) ? 0 : 1);
+}